@@ -0,0 +1,211 @@
+#include "config.h"
+
+#include "average-chart.h"
+
+#include <math.h>
+#include <glib/gi18n.h>
+
+G_DEFINE_TYPE (OgAverageChart, og_average_chart, GTK_TYPE_DRAWING_AREA)
+
+/* Space around the pie and between the pie and the legend, in pixels */
+#define MARGIN 20
+
+/* Side of legend squares and space between legend entries, in pixels */
+#define LEGEND_BOX_SIZE 12
+#define LEGEND_SPACING 6
+
+/* Slices smaller than that, in percent, are not labelled */
+#define MIN_LABELLED_PERCENT 3
+
+enum
+{
+  SLICE_HYPO,
+  SLICE_GOOD,
+  SLICE_HYPER,
+  N_SLICES
+};
+
+struct _OgAverageChartPrivate
+{
+  guint counts[N_SLICES];
+};
+
+/* Same colors as the threshold bands of the modal day */
+static const struct
+{
+  const gchar *name;
+  gdouble red;
+  gdouble green;
+  gdouble blue;
+} slices[N_SLICES] = {
+  { N_("Hypoglycemia"), 0.3, 0.3, 1 },
+  { N_("Good"), 0.3, 0.8, 0.3 },
+  { N_("Hyperglycemia"), 1, 0.3, 0.3 },
+};
+
+static PangoLayout *
+create_layout (GtkWidget *widget,
+    const gchar *text,
+    gint *width,
+    gint *height)
+{
+  PangoLayout *layout;
+
+  layout = gtk_widget_create_pango_layout (widget, text);
+  pango_layout_get_pixel_size (layout, width, height);
+
+  return layout;
+}
+
+static gint
+draw_legend (OgAverageChart *self,
+    cairo_t *cr,
+    const GdkRGBA *color,
+    gint right,
+    gint center_y)
+{
+  GtkWidget *widget = (GtkWidget *) self;
+  PangoLayout *layouts[N_SLICES];
+  gint width = 0;
+  gint line_height = LEGEND_BOX_SIZE;
+  gint x, y;
+  guint i;
+
+  for (i = 0; i < N_SLICES; i++)
+    {
+      gint w, h;
+
+      layouts[i] = create_layout (widget, _(slices[i].name), &w, &h);
+      width = MAX (width, w);
+      line_height = MAX (line_height, h);
+    }
+
+  x = right - width - LEGEND_BOX_SIZE - LEGEND_SPACING;
+  y = center_y - (N_SLICES * (line_height + LEGEND_SPACING)) / 2;
+  for (i = 0; i < N_SLICES; i++)
+    {
+      cairo_set_source_rgb (cr, slices[i].red, slices[i].green,
+          slices[i].blue);
+      cairo_rectangle (cr, x, y + (line_height - LEGEND_BOX_SIZE) / 2,
+          LEGEND_BOX_SIZE, LEGEND_BOX_SIZE);
+      cairo_fill (cr);
+
+      gdk_cairo_set_source_rgba (cr, color);
+      cairo_move_to (cr, x + LEGEND_BOX_SIZE + LEGEND_SPACING, y);
+      pango_cairo_show_layout (cr, layouts[i]);
+      g_object_unref (layouts[i]);
+
+      y += line_height + LEGEND_SPACING;
+    }
+
+  return x;
+}
+
+static gboolean
+draw (GtkWidget *widget,
+    cairo_t *cr)
+{
+  OgAverageChart *self = (OgAverageChart *) widget;
+  GdkRGBA color;
+  gint width, height;
+  gint legend_x;
+  gdouble cx, cy, radius;
+  gdouble angle;
+  guint total;
+  guint i;
+
+  total = self->priv->counts[SLICE_HYPO] + self->priv->counts[SLICE_GOOD] +
+      self->priv->counts[SLICE_HYPER];
+  if (total == 0)
+    return FALSE;
+
+  width = gtk_widget_get_allocated_width (widget);
+  height = gtk_widget_get_allocated_height (widget);
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+      gtk_widget_get_state_flags (widget), &color);
+
+  /* Legend on the right, pie centered in the remaining space */
+  legend_x = draw_legend (self, cr, &color, width - MARGIN, height / 2);
+  radius = MIN (legend_x - 2 * MARGIN, height - 2 * MARGIN) / 2.0;
+  if (radius <= 0)
+    return FALSE;
+  cx = (legend_x - MARGIN) / 2.0;
+  cy = height / 2.0;
+
+  angle = -G_PI / 2;
+  for (i = 0; i < N_SLICES; i++)
+    {
+      gdouble sweep = 2 * G_PI * self->priv->counts[i] / total;
+      gdouble percent = 100.0 * self->priv->counts[i] / total;
+
+      if (self->priv->counts[i] == 0)
+        continue;
+
+      cairo_set_source_rgb (cr, slices[i].red, slices[i].green,
+          slices[i].blue);
+      cairo_move_to (cr, cx, cy);
+      cairo_arc (cr, cx, cy, radius, angle, angle + sweep);
+      cairo_close_path (cr);
+      cairo_fill (cr);
+
+      if (percent >= MIN_LABELLED_PERCENT)
+        {
+          PangoLayout *layout;
+          gchar *text;
+          gint w, h;
+
+          text = g_strdup_printf ("%.0f%%", percent);
+          layout = create_layout (widget, text, &w, &h);
+          gdk_cairo_set_source_rgba (cr, &color);
+          cairo_move_to (cr,
+              cx + 0.7 * radius * cos (angle + sweep / 2) - w / 2.0,
+              cy + 0.7 * radius * sin (angle + sweep / 2) - h / 2.0);
+          pango_cairo_show_layout (cr, layout);
+          g_object_unref (layout);
+          g_free (text);
+        }
+
+      angle += sweep;
+    }
+
+  return FALSE;
+}
+
+static void
+og_average_chart_init (OgAverageChart *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      OG_TYPE_AVERAGE_CHART, OgAverageChartPrivate);
+}
+
+static void
+og_average_chart_class_init (OgAverageChartClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  widget_class->draw = draw;
+
+  g_type_class_add_private (object_class, sizeof (OgAverageChartPrivate));
+}
+
+GtkWidget *
+og_average_chart_new (void)
+{
+  return g_object_new (OG_TYPE_AVERAGE_CHART, NULL);
+}
+
+/* Takes ownership of @data, only the counts are kept */
+void
+og_average_chart_set_data (OgAverageChart *self,
+    OgChartData *data)
+{
+  g_return_if_fail (OG_IS_AVERAGE_CHART (self));
+  g_return_if_fail (data != NULL);
+
+  og_chart_data_classify (data, &self->priv->counts[SLICE_HYPO],
+      &self->priv->counts[SLICE_GOOD], &self->priv->counts[SLICE_HYPER]);
+  og_chart_data_free (data);
+
+  gtk_widget_queue_draw ((GtkWidget *) self);
+}
@@ -0,0 +1,49 @@
+#ifndef __OG_AVERAGE_CHART_H__
+#define __OG_AVERAGE_CHART_H__
+
+#include <gtk/gtk.h>
+
+#include "chart-data.h"
+
+G_BEGIN_DECLS
+
+#define OG_TYPE_AVERAGE_CHART \
+    (og_average_chart_get_type ())
+#define OG_AVERAGE_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST ((obj), OG_TYPE_AVERAGE_CHART, \
+        OgAverageChart))
+#define OG_AVERAGE_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST ((klass), OG_TYPE_AVERAGE_CHART, \
+        OgAverageChartClass))
+#define OG_IS_AVERAGE_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE ((obj), OG_TYPE_AVERAGE_CHART))
+#define OG_IS_AVERAGE_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE ((klass), OG_TYPE_AVERAGE_CHART))
+#define OG_AVERAGE_CHART_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS ((obj), OG_TYPE_AVERAGE_CHART, \
+        OgAverageChartClass))
+
+typedef struct _OgAverageChart OgAverageChart;
+typedef struct _OgAverageChartClass OgAverageChartClass;
+typedef struct _OgAverageChartPrivate OgAverageChartPrivate;
+
+struct _OgAverageChart {
+  GtkDrawingArea parent;
+
+  OgAverageChartPrivate *priv;
+};
+
+struct _OgAverageChartClass {
+  GtkDrawingAreaClass parent_class;
+};
+
+GType og_average_chart_get_type (void) G_GNUC_CONST;
+
+GtkWidget *og_average_chart_new (void);
+
+void og_average_chart_set_data (OgAverageChart *self,
+    OgChartData *data);
+
+G_END_DECLS
+
+#endif /* __OG_AVERAGE_CHART_H__ */
@@ -24,3 +24,12 @@ function OgChartRePlot(data)
 {
   plot.replot({resetAxis: true, data: [data]});
 }
+
+/* Plots the first time, replots afterwards */
+function OgChartUpdate(title, data)
+{
+  if (plot === undefined)
+    OgChartPlot(title, data);
+  else
+    OgChartRePlot(data);
+}
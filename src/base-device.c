@@ -4,18 +4,59 @@
 
 #include <string.h>
 
+#include "trace.h"
+
 G_DEFINE_QUARK (og-base-device-error-quark, og_base_device_error)
 G_DEFINE_ABSTRACT_TYPE (OgBaseDevice, og_base_device, G_TYPE_OBJECT)
 
+/* Rates are measured over windows of that length */
+#define METRICS_WINDOW_SECONDS 1
+
+/* Don't notify progress more often than that */
+#define PROGRESS_NOTIFY_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+
+struct _OgBaseDevicePrivate
+{
+  OgDeviceMetrics *metrics;
+  guint metrics_source_id;
+  gint64 metrics_window_start;
+
+  gdouble progress;
+  guint n_records_received;
+  gint64 progress_last_notify;
+
+  OgStats *stats;
+  /* Per span, bitmask of those up to date with stats */
+  OgVariability variability[OG_N_TIME_SPANS];
+  guint variability_valid;
+
+  OgEpisodeDetector *episodes;
+  guint n_episode_records;
+
+  OgTimeline *timeline;
+  OgCalendar *calendar;
+};
+
 enum
 {
   PROP_0,
   PROP_STATUS,
+  PROP_FRAMES_PER_SECOND,
+  PROP_BYTES_PER_SECOND,
+  PROP_RECORDS_PER_SECOND,
+  PROP_CHECKSUM_FAILURES,
+  PROP_RETRIES,
+  PROP_PROGRESS,
+  PROP_N_RECORDS_RECEIVED,
 };
 
 static void
 og_base_device_init (OgBaseDevice *self)
 {
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      OG_TYPE_BASE_DEVICE, OgBaseDevicePrivate);
+
+  self->priv->metrics = og_device_metrics_new ();
 }
 
 static void
@@ -35,6 +76,14 @@ finalize (GObject *object)
 
   g_debug ("Finalize device %p", self);
 
+  if (self->priv->metrics_source_id != 0)
+    g_source_remove (self->priv->metrics_source_id);
+  og_device_metrics_free (self->priv->metrics);
+  og_stats_free (self->priv->stats);
+  og_episode_detector_free (self->priv->episodes);
+  og_timeline_free (self->priv->timeline);
+  og_calendar_free (self->priv->calendar);
+
   G_OBJECT_CLASS (og_base_device_parent_class)->finalize (object);
 }
 
@@ -51,12 +100,71 @@ get_property (GObject *object,
       case PROP_STATUS:
         g_value_set_uint (value, og_base_device_get_status (self));
         break;
+      case PROP_FRAMES_PER_SECOND:
+        g_value_set_double (value, self->priv->metrics->frames_per_second);
+        break;
+      case PROP_BYTES_PER_SECOND:
+        g_value_set_double (value, self->priv->metrics->bytes_per_second);
+        break;
+      case PROP_RECORDS_PER_SECOND:
+        g_value_set_double (value, self->priv->metrics->records_per_second);
+        break;
+      case PROP_CHECKSUM_FAILURES:
+        g_value_set_uint (value, self->priv->metrics->n_checksum_failures);
+        break;
+      case PROP_RETRIES:
+        g_value_set_uint (value, self->priv->metrics->n_retries);
+        break;
+      case PROP_PROGRESS:
+        g_value_set_double (value, self->priv->progress);
+        break;
+      case PROP_N_RECORDS_RECEIVED:
+        g_value_set_uint (value, self->priv->n_records_received);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
         break;
     }
 }
 
+static void
+account_memory (OgBaseDevice *self,
+    OgMemoryUsage *usage)
+{
+  const OgRecord * const *records;
+  OgDeviceMetrics *metrics = self->priv->metrics;
+  gsize n_records = 0;
+
+  og_memory_usage_add (usage, "device", sizeof (OgBaseDevicePrivate));
+  og_memory_usage_add (usage, "metrics", sizeof (OgDeviceMetrics) +
+      metrics->latencies->len *
+          (sizeof (gpointer) + sizeof (OgLatencyHistogram)));
+
+  records = og_base_device_get_records (self);
+  if (records == NULL)
+    return;
+
+  while (records[n_records] != NULL)
+    n_records++;
+
+  og_memory_usage_add (usage, "records",
+      (n_records + 1) * sizeof (gpointer) + n_records * sizeof (OgRecord));
+  og_memory_usage_add (usage, "records datetimes",
+      n_records * OG_DATE_TIME_SIZE);
+
+  if (self->priv->stats != NULL)
+    og_memory_usage_add (usage, "stats", og_stats_get_size (self->priv->stats));
+  if (self->priv->episodes != NULL)
+    og_memory_usage_add (usage, "episodes",
+        og_episode_detector_get_size (self->priv->episodes));
+  if (self->priv->timeline != NULL)
+    og_memory_usage_add (usage, "timeline",
+        og_timeline_get_size (self->priv->timeline));
+  if (self->priv->calendar != NULL)
+    og_memory_usage_add (usage, "calendar",
+        og_calendar_get_size (self->priv->calendar));
+}
+
 static void
 og_base_device_class_init (OgBaseDeviceClass *klass)
 {
@@ -67,6 +175,10 @@ og_base_device_class_init (OgBaseDeviceClass *klass)
   object_class->finalize = finalize;
   object_class->get_property = get_property;
 
+  klass->account_memory = account_memory;
+
+  g_type_class_add_private (object_class, sizeof (OgBaseDevicePrivate));
+
   param_spec = g_param_spec_uint ("status",
       "Status",
       "The current status of this device",
@@ -75,6 +187,61 @@ og_base_device_class_init (OgBaseDeviceClass *klass)
       OG_BASE_DEVICE_STATUS_NONE,
       G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
   g_object_class_install_property (object_class, PROP_STATUS, param_spec);
+
+  param_spec = g_param_spec_double ("frames-per-second",
+      "Frames per second",
+      "The number of buffers received from the device per second",
+      0, G_MAXDOUBLE, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_FRAMES_PER_SECOND,
+      param_spec);
+
+  param_spec = g_param_spec_double ("bytes-per-second",
+      "Bytes per second",
+      "The number of bytes received from the device per second",
+      0, G_MAXDOUBLE, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_BYTES_PER_SECOND,
+      param_spec);
+
+  param_spec = g_param_spec_double ("records-per-second",
+      "Records per second",
+      "The number of records received from the device per second",
+      0, G_MAXDOUBLE, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_RECORDS_PER_SECOND,
+      param_spec);
+
+  param_spec = g_param_spec_uint ("checksum-failures",
+      "Checksum failures",
+      "The number of replies received with a wrong checksum",
+      0, G_MAXUINT, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_CHECKSUM_FAILURES,
+      param_spec);
+
+  param_spec = g_param_spec_uint ("retries",
+      "Retries",
+      "The number of unexpected replies discarded while waiting for the "
+      "expected one",
+      0, G_MAXUINT, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_RETRIES, param_spec);
+
+  param_spec = g_param_spec_double ("progress",
+      "Progress",
+      "The fraction of the records downloaded so far",
+      0, 1, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_PROGRESS, param_spec);
+
+  param_spec = g_param_spec_uint ("n-records-received",
+      "Records received",
+      "The number of records downloaded so far",
+      0, G_MAXUINT, 0,
+      G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+  g_object_class_install_property (object_class, PROP_N_RECORDS_RECEIVED,
+      param_spec);
 }
 
 OgBaseDeviceStatus
@@ -234,3 +401,473 @@ og_base_device_get_last_name (OgBaseDevice *self)
 
   return klass->get_last_name (self);
 }
+
+void
+og_base_device_account_memory (OgBaseDevice *self,
+    OgMemoryUsage *usage)
+{
+  OgBaseDeviceClass *klass;
+
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+  g_return_if_fail (usage != NULL);
+
+  klass = OG_BASE_DEVICE_GET_CLASS (self);
+  g_return_if_fail (klass->account_memory != NULL);
+
+  klass->account_memory (self, usage);
+}
+
+/* Returns the aggregates of all records received so far. They are only
+ * computed for records added since the previous call, or again from scratch
+ * when the day changed. */
+OgStats *
+og_base_device_get_stats (OgBaseDevice *self)
+{
+  const OgRecord * const *records;
+  GDateTime *now;
+  guint i;
+
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), NULL);
+
+  records = og_base_device_get_records (self);
+  g_return_val_if_fail (records != NULL, NULL);
+
+  now = g_date_time_new_now_local ();
+  if (self->priv->stats != NULL &&
+      !og_stats_is_current (self->priv->stats, now))
+    g_clear_pointer (&self->priv->stats, og_stats_free);
+  if (self->priv->stats == NULL)
+    {
+      self->priv->stats = og_stats_new (now);
+      self->priv->variability_valid = 0;
+    }
+  g_date_time_unref (now);
+
+  /* Records are only ever appended */
+  for (i = og_stats_get_n_records (self->priv->stats); records[i] != NULL; i++)
+    {
+      og_stats_add_record (self->priv->stats, records[i]);
+      self->priv->variability_valid = 0;
+    }
+
+  return self->priv->stats;
+}
+
+/* Returns the timeline of all records received so far, extended with those
+ * added since the previous call. */
+const OgTimeline *
+og_base_device_get_timeline (OgBaseDevice *self)
+{
+  const OgRecord * const *records;
+  guint i;
+
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), NULL);
+
+  records = og_base_device_get_records (self);
+  g_return_val_if_fail (records != NULL, NULL);
+
+  if (self->priv->timeline == NULL)
+    self->priv->timeline = og_timeline_new ();
+
+  /* Records are only ever appended */
+  og_trace_begin ("update-timeline");
+  for (i = og_timeline_get_n_records (self->priv->timeline);
+       records[i] != NULL; i++)
+    og_timeline_add_record (self->priv->timeline, records[i]);
+  og_trace_end ("update-timeline");
+
+  return self->priv->timeline;
+}
+
+/* Returns the per day summaries of all records received so far. Those added
+ * since the previous call are added to them, unless thresholds changed, then
+ * they are computed again in a single pass over all records. */
+const OgCalendar *
+og_base_device_get_calendar (OgBaseDevice *self,
+    guint hypoglycemia,
+    guint hyperglycemia)
+{
+  const OgRecord * const *records;
+  guint i;
+
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), NULL);
+  g_return_val_if_fail (hypoglycemia <= hyperglycemia, NULL);
+
+  records = og_base_device_get_records (self);
+  g_return_val_if_fail (records != NULL, NULL);
+
+  if (self->priv->calendar != NULL &&
+      !og_calendar_has_thresholds (self->priv->calendar, hypoglycemia,
+          hyperglycemia))
+    g_clear_pointer (&self->priv->calendar, og_calendar_free);
+  if (self->priv->calendar == NULL)
+    self->priv->calendar = og_calendar_new (hypoglycemia, hyperglycemia);
+
+  /* Records are only ever appended */
+  og_trace_begin ("update-calendar");
+  for (i = og_calendar_get_n_records (self->priv->calendar);
+       records[i] != NULL; i++)
+    og_calendar_add_record (self->priv->calendar, records[i]);
+  og_trace_end ("update-calendar");
+
+  return self->priv->calendar;
+}
+
+static gint
+compare_records (gconstpointer a,
+    gconstpointer b)
+{
+  const OgRecord *ra = *(const OgRecord **) a;
+  const OgRecord *rb = *(const OgRecord **) b;
+
+  return g_date_time_compare (ra->datetime, rb->datetime);
+}
+
+/* Returns the records of @span in time order. Devices give them in either
+ * order, they are sorted only if they are not. */
+static GPtrArray *
+dup_records_in_order (OgBaseDevice *self,
+    OgStats *stats,
+    OgTimeSpan span)
+{
+  const OgRecord * const *records;
+  GPtrArray *sorted;
+  gboolean ascending = TRUE;
+  gboolean descending = TRUE;
+  guint i;
+
+  records = og_base_device_get_records (self);
+
+  sorted = g_ptr_array_new ();
+  for (i = 0; records[i] != NULL; i++)
+    {
+      if (og_stats_get_record_span (stats, records[i]) > span)
+        continue;
+
+      if (sorted->len > 0)
+        {
+          const OgRecord *last = g_ptr_array_index (sorted, sorted->len - 1);
+          gint cmp = g_date_time_compare (last->datetime, records[i]->datetime);
+
+          ascending = ascending && cmp <= 0;
+          descending = descending && cmp >= 0;
+        }
+      g_ptr_array_add (sorted, (gpointer) records[i]);
+    }
+
+  if (!ascending && !descending)
+    {
+      g_ptr_array_sort (sorted, compare_records);
+    }
+  else if (!ascending)
+    {
+      for (i = 0; i < sorted->len / 2; i++)
+        {
+          gpointer tmp = sorted->pdata[i];
+
+          sorted->pdata[i] = sorted->pdata[sorted->len - 1 - i];
+          sorted->pdata[sorted->len - 1 - i] = tmp;
+        }
+    }
+
+  return sorted;
+}
+
+static void
+compute_variability (OgBaseDevice *self,
+    OgStats *stats,
+    OgTimeSpan span,
+    OgVariability *variability)
+{
+  OgVariabilityBuilder *builder;
+  GPtrArray *sorted;
+  guint i;
+
+  sorted = dup_records_in_order (self, stats, span);
+
+  builder = og_variability_builder_new ();
+  for (i = 0; i < sorted->len; i++)
+    {
+      const OgRecord *record = g_ptr_array_index (sorted, i);
+
+      og_variability_builder_add (builder,
+          g_date_time_to_unix (record->datetime), record->glycemia);
+    }
+  og_variability_builder_finish (builder, variability);
+
+  og_variability_builder_free (builder);
+  g_ptr_array_unref (sorted);
+}
+
+/* Glycemic variability indices of @span, computed again only when records
+ * were added. */
+const OgVariability *
+og_base_device_get_variability (OgBaseDevice *self,
+    OgTimeSpan span)
+{
+  OgStats *stats;
+
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), NULL);
+  g_return_val_if_fail (span < OG_N_TIME_SPANS, NULL);
+
+  stats = og_base_device_get_stats (self);
+  g_return_val_if_fail (stats != NULL, NULL);
+
+  if (!(self->priv->variability_valid & (1 << span)))
+    {
+      og_trace_begin ("compute-variability");
+      compute_variability (self, stats, span, &self->priv->variability[span]);
+      og_trace_end ("compute-variability");
+      self->priv->variability_valid |= 1 << span;
+    }
+
+  return &self->priv->variability[span];
+}
+
+/* New records are fed to the detector as long as they come in time order,
+ * otherwise, or if thresholds or the gap tolerance changed, it is built again
+ * from all records. */
+static void
+update_episodes (OgBaseDevice *self,
+    OgStats *stats,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap)
+{
+  const OgRecord * const *records;
+  OgEpisodeDetector *detector = self->priv->episodes;
+  GPtrArray *sorted;
+  gint64 last_time;
+  guint i;
+
+  records = og_base_device_get_records (self);
+
+  if (detector != NULL &&
+      og_episode_detector_has_settings (detector, hypoglycemia,
+          hyperglycemia, max_gap))
+    {
+      last_time = og_episode_detector_get_last_time (detector);
+      for (i = self->priv->n_episode_records; records[i] != NULL; i++)
+        {
+          gint64 time = g_date_time_to_unix (records[i]->datetime);
+
+          if (time < last_time)
+            break;
+          last_time = time;
+        }
+
+      if (records[i] == NULL)
+        {
+          for (i = self->priv->n_episode_records; records[i] != NULL; i++)
+            og_episode_detector_add (detector,
+                g_date_time_to_unix (records[i]->datetime),
+                records[i]->glycemia);
+          self->priv->n_episode_records = i;
+          return;
+        }
+    }
+
+  og_trace_begin ("detect-episodes");
+
+  og_episode_detector_free (detector);
+  detector = og_episode_detector_new (hypoglycemia, hyperglycemia, max_gap);
+  self->priv->episodes = detector;
+
+  sorted = dup_records_in_order (self, stats, OG_TIME_SPAN_ALL);
+  for (i = 0; i < sorted->len; i++)
+    {
+      const OgRecord *record = g_ptr_array_index (sorted, i);
+
+      og_episode_detector_add (detector,
+          g_date_time_to_unix (record->datetime), record->glycemia);
+    }
+  self->priv->n_episode_records = sorted->len;
+  g_ptr_array_unref (sorted);
+
+  og_trace_end ("detect-episodes");
+}
+
+/* Hypoglycemia and hyperglycemia episodes overlapping @span, oldest first.
+ * Out of range readings up to @max_gap seconds apart, e.g.
+ * OG_EPISODE_MAX_GAP, are in the same episode. */
+const OgEpisode *
+og_base_device_get_episodes (OgBaseDevice *self,
+    OgTimeSpan span,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap,
+    guint *n_episodes)
+{
+  OgStats *stats;
+  GDateTime *now;
+  GDateTime *start;
+  gint64 since = G_MININT64;
+  gint n_days;
+
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), NULL);
+  g_return_val_if_fail (span < OG_N_TIME_SPANS, NULL);
+  g_return_val_if_fail (hypoglycemia <= hyperglycemia, NULL);
+  g_return_val_if_fail (max_gap >= 0, NULL);
+  g_return_val_if_fail (n_episodes != NULL, NULL);
+
+  stats = og_base_device_get_stats (self);
+  g_return_val_if_fail (stats != NULL, NULL);
+
+  update_episodes (self, stats, hypoglycemia, hyperglycemia, max_gap);
+
+  /* Spans start at midnight */
+  n_days = og_time_span_get_n_days (span);
+  if (n_days > 0)
+    {
+      now = g_date_time_new_now_local ();
+      start = g_date_time_new_local (g_date_time_get_year (now),
+          g_date_time_get_month (now), g_date_time_get_day_of_month (now),
+          0, 0, 0);
+      since = g_date_time_to_unix (start) - (n_days - 1) * 24 * 60 * 60;
+      g_date_time_unref (start);
+      g_date_time_unref (now);
+    }
+
+  return og_episode_detector_get_since (self->priv->episodes, since,
+      n_episodes);
+}
+
+OgDeviceMetrics *
+og_base_device_dup_metrics (OgBaseDevice *self)
+{
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), NULL);
+
+  return og_device_metrics_copy (self->priv->metrics);
+}
+
+static gboolean
+metrics_window_cb (gpointer user_data)
+{
+  OgBaseDevice *self = user_data;
+  gint64 now;
+  gboolean active;
+
+  now = g_get_monotonic_time ();
+  active = og_device_metrics_update_rates (self->priv->metrics,
+      now - self->priv->metrics_window_start);
+  self->priv->metrics_window_start = now;
+
+  g_object_freeze_notify ((GObject *) self);
+  g_object_notify ((GObject *) self, "frames-per-second");
+  g_object_notify ((GObject *) self, "bytes-per-second");
+  g_object_notify ((GObject *) self, "records-per-second");
+  g_object_thaw_notify ((GObject *) self);
+
+  /* Rates are now 0, stop ticking until the device talks again */
+  if (!active)
+    {
+      self->priv->metrics_source_id = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+metrics_ensure_window (OgBaseDevice *self)
+{
+  if (self->priv->metrics_source_id != 0)
+    return;
+
+  self->priv->metrics_window_start = g_get_monotonic_time ();
+  self->priv->metrics_source_id = g_timeout_add_seconds (
+      METRICS_WINDOW_SECONDS, metrics_window_cb, self);
+}
+
+void
+og_base_device_metrics_command_done (OgBaseDevice *self,
+    const gchar *command,
+    GTimeSpan latency)
+{
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+
+  og_device_metrics_add_latency (self->priv->metrics, command, latency);
+}
+
+void
+og_base_device_metrics_frame_received (OgBaseDevice *self,
+    gsize n_bytes)
+{
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+
+  og_device_metrics_add_frame (self->priv->metrics, n_bytes);
+  metrics_ensure_window (self);
+}
+
+void
+og_base_device_metrics_record_received (OgBaseDevice *self)
+{
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+
+  og_device_metrics_add_record (self->priv->metrics);
+  metrics_ensure_window (self);
+}
+
+void
+og_base_device_metrics_checksum_failed (OgBaseDevice *self)
+{
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+
+  self->priv->metrics->n_checksum_failures++;
+  g_object_notify ((GObject *) self, "checksum-failures");
+}
+
+void
+og_base_device_metrics_retried (OgBaseDevice *self)
+{
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+
+  self->priv->metrics->n_retries++;
+  g_object_notify ((GObject *) self, "retries");
+}
+
+gdouble
+og_base_device_get_progress (OgBaseDevice *self,
+    guint *n_records_received)
+{
+  g_return_val_if_fail (OG_IS_BASE_DEVICE (self), 0);
+
+  if (n_records_received != NULL)
+    *n_records_received = self->priv->n_records_received;
+
+  return self->priv->progress;
+}
+
+/* @n_expected is the total number of records, or 0 until the device tells
+ * it, in which case the progress stays at 0. The InsuLinx only tells it with
+ * its last record, so there is no time left to estimate. */
+void
+og_base_device_update_progress (OgBaseDevice *self,
+    guint n_received,
+    guint n_expected)
+{
+  gint64 now;
+  gboolean done;
+
+  g_return_if_fail (OG_IS_BASE_DEVICE (self));
+
+  now = g_get_monotonic_time ();
+  if (n_expected > 0)
+    n_received = MIN (n_received, n_expected);
+  done = (n_received == n_expected);
+
+  self->priv->progress = n_expected > 0 ?
+      (gdouble) n_received / n_expected : 0;
+  self->priv->n_records_received = n_received;
+
+  if (!done &&
+      now - self->priv->progress_last_notify < PROGRESS_NOTIFY_INTERVAL)
+    return;
+
+  self->priv->progress_last_notify = now;
+
+  g_object_freeze_notify ((GObject *) self);
+  g_object_notify ((GObject *) self, "progress");
+  g_object_notify ((GObject *) self, "n-records-received");
+  g_object_thaw_notify ((GObject *) self);
+}
@@ -3,7 +3,14 @@
 
 #include <gusb.h>
 
+#include "calendar.h"
+#include "device-metrics.h"
+#include "episodes.h"
+#include "memory-usage.h"
 #include "record.h"
+#include "stats.h"
+#include "timeline.h"
+#include "variability.h"
 
 G_BEGIN_DECLS
 
@@ -82,6 +89,11 @@ struct _OgBaseDeviceClass {
   const OgRecord * const *(*get_records) (OgBaseDevice *self);
   const gchar *(*get_first_name) (OgBaseDevice *self);
   const gchar *(*get_last_name) (OgBaseDevice *self);
+
+  /* Default implementation accounts records and metrics, subclasses should
+   * chain up and add what they own. */
+  void (*account_memory) (OgBaseDevice *self,
+      OgMemoryUsage *usage);
 };
 
 GType og_base_device_get_type (void) G_GNUC_CONST;
@@ -113,6 +125,50 @@ GDateTime *og_base_device_get_clock (OgBaseDevice *self,
 const OgRecord * const *og_base_device_get_records (OgBaseDevice *self);
 const gchar *og_base_device_get_first_name (OgBaseDevice *self);
 const gchar *og_base_device_get_last_name (OgBaseDevice *self);
+void og_base_device_account_memory (OgBaseDevice *self,
+    OgMemoryUsage *usage);
+
+/* Aggregates */
+
+OgStats *og_base_device_get_stats (OgBaseDevice *self);
+const OgVariability *og_base_device_get_variability (OgBaseDevice *self,
+    OgTimeSpan span);
+const OgEpisode *og_base_device_get_episodes (OgBaseDevice *self,
+    OgTimeSpan span,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap,
+    guint *n_episodes);
+const OgTimeline *og_base_device_get_timeline (OgBaseDevice *self);
+const OgCalendar *og_base_device_get_calendar (OgBaseDevice *self,
+    guint hypoglycemia,
+    guint hyperglycemia);
+
+/* Metrics */
+
+OgDeviceMetrics *og_base_device_dup_metrics (OgBaseDevice *self);
+
+/* Download progress */
+
+gdouble og_base_device_get_progress (OgBaseDevice *self,
+    guint *n_records_received);
+
+/* Protected, for subclasses to feed the metrics */
+
+void og_base_device_metrics_command_done (OgBaseDevice *self,
+    const gchar *command,
+    GTimeSpan latency);
+void og_base_device_metrics_frame_received (OgBaseDevice *self,
+    gsize n_bytes);
+void og_base_device_metrics_record_received (OgBaseDevice *self);
+void og_base_device_metrics_checksum_failed (OgBaseDevice *self);
+void og_base_device_metrics_retried (OgBaseDevice *self);
+
+/* Protected, for subclasses to report download progress */
+
+void og_base_device_update_progress (OgBaseDevice *self,
+    guint n_received,
+    guint n_expected);
 
 G_END_DECLS
 
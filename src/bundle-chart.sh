@@ -0,0 +1,31 @@
+#!/bin/sh
+# Inlines the given stylesheets and scripts into the chart page template, in
+# place of its @BUNDLE@ line, so the page loads without any subresource.
+#
+# Usage: bundle-chart.sh TEMPLATE FILE...
+
+set -e
+
+template=$1
+shift
+
+sed -n '/@BUNDLE@/q;p' "$template"
+for file in "$@"; do
+  case "$file" in
+    *.css)
+      echo '<style>'
+      cat "$file"
+      echo '</style>'
+      ;;
+    *.js)
+      echo '<script charset="utf-8">'
+      cat "$file"
+      echo '</script>'
+      ;;
+    *)
+      echo "$0: unsupported file $file" >&2
+      exit 1
+      ;;
+  esac
+done
+sed '1,/@BUNDLE@/d' "$template"
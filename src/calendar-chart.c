@@ -0,0 +1,447 @@
+#include "config.h"
+
+#include "calendar-chart.h"
+
+#include <glib/gi18n.h>
+
+#include "chart-drawing.h"
+
+G_DEFINE_TYPE (OgCalendarChart, og_calendar_chart, GTK_TYPE_DRAWING_AREA)
+
+/* Space around the tiles for the title and labels, in pixels */
+#define MARGIN_TOP 50
+#define MARGIN_BOTTOM 10
+#define MARGIN_LEFT 50
+#define MARGIN_RIGHT 20
+
+/* Side of a day tile, and distance between tiles, in pixels */
+#define TILE_SIZE 12
+#define TILE_PITCH 14
+
+#define DAYS_PER_WEEK 7
+
+/* ARGB colors of tiles. Days without readings are drawn with the text color
+ * of the widget. */
+#define EMPTY_TILE 0
+/* Not drawn on the surface yet, no tile has that color */
+#define UNDRAWN_TILE G_MAXUINT32
+
+/* By time in range, below 50%, 70%, 90% and above */
+static const guint32 time_in_range_colors[] = {
+  0xffc6e48b, 0xff7bc96f, 0xff239a3b, 0xff196127,
+};
+
+/* By mean glucose: hypoglycemia, good and hyperglycemia */
+static const guint32 mean_colors[] = {
+  0xff3b6fd6, 0xff7bc96f, 0xffe05d44,
+};
+
+struct _OgCalendarChartPrivate
+{
+  /* Borrowed from the device, NULL until set */
+  const OgCalendar *calendar;
+  OgCalendarMode mode;
+
+  /* Weeks are columns starting on Monday, days are numbered from the Unix
+   * epoch */
+  gint64 first_monday;
+  guint n_weeks;
+
+  /* The whole calendar is rendered once, then only tiles whose color changed
+   * are drawn again, so drawing and scrolling just paint this surface */
+  cairo_surface_t *surface;
+  /* GArray<guint32>, color of each tile on the surface, from first_monday */
+  GArray *tile_colors;
+};
+
+/* Monday is 0, the Unix epoch was a Thursday */
+static guint
+get_weekday (gint64 day)
+{
+  return ((day + 3) % DAYS_PER_WEEK + DAYS_PER_WEEK) % DAYS_PER_WEEK;
+}
+
+static GDateTime *
+dup_date (gint64 day)
+{
+  /* Day numbers are local, their UTC midnight has the same date */
+  return g_date_time_new_from_unix_utc (day * OG_SECONDS_PER_DAY);
+}
+
+static void
+get_tile_position (OgCalendarChart *self,
+    gint64 day,
+    gint *x,
+    gint *y)
+{
+  gint64 index = day - self->priv->first_monday;
+
+  *x = MARGIN_LEFT + index / DAYS_PER_WEEK * TILE_PITCH;
+  *y = MARGIN_TOP + get_weekday (day) * TILE_PITCH;
+}
+
+static guint32
+get_tile_color (OgCalendarChart *self,
+    const OgCalendarDay *day)
+{
+  guint hypoglycemia, hyperglycemia;
+  guint in_range;
+  guint mean;
+
+  if (day->n_values == 0)
+    return EMPTY_TILE;
+
+  if (self->priv->mode == OG_CALENDAR_MODE_MEAN)
+    {
+      og_calendar_get_thresholds (self->priv->calendar, &hypoglycemia,
+          &hyperglycemia);
+      mean = day->sum / day->n_values;
+      if (mean < hypoglycemia)
+        return mean_colors[0];
+      if (mean >= hyperglycemia)
+        return mean_colors[2];
+      return mean_colors[1];
+    }
+
+  in_range = 100 * (day->n_values - day->n_hypo - day->n_hyper) /
+      day->n_values;
+  if (in_range < 50)
+    return time_in_range_colors[0];
+  if (in_range < 70)
+    return time_in_range_colors[1];
+  if (in_range < 90)
+    return time_in_range_colors[2];
+  return time_in_range_colors[3];
+}
+
+static void
+draw_tile (cairo_t *cr,
+    const GdkRGBA *empty_color,
+    gint x,
+    gint y,
+    guint32 color)
+{
+  cairo_rectangle (cr, x, y, TILE_SIZE, TILE_SIZE);
+  if (color == EMPTY_TILE)
+    cairo_set_source_rgba (cr, empty_color->red, empty_color->green,
+        empty_color->blue, 0.1);
+  else
+    cairo_set_source_rgba (cr,
+        ((color >> 16) & 0xff) / 255.0,
+        ((color >> 8) & 0xff) / 255.0,
+        (color & 0xff) / 255.0,
+        (color >> 24) / 255.0);
+  cairo_fill (cr);
+}
+
+/* Draws again the tiles of days whose color changed, on the surface if it is
+ * rendered already */
+static void
+update_tiles (OgCalendarChart *self)
+{
+  GtkWidget *widget = (GtkWidget *) self;
+  const OgCalendarDay *days;
+  gint64 first_day;
+  guint n_days;
+  GdkRGBA color;
+  cairo_t *cr;
+  guint i;
+
+  if (self->priv->surface == NULL)
+    return;
+
+  days = og_calendar_get_days (self->priv->calendar, &first_day, &n_days);
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+      gtk_widget_get_state_flags (widget), &color);
+
+  cr = cairo_create (self->priv->surface);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  for (i = 0; i < n_days; i++)
+    {
+      guint32 *drawn;
+      guint32 tile_color;
+      gint x, y;
+
+      drawn = &g_array_index (self->priv->tile_colors, guint32,
+          first_day + i - self->priv->first_monday);
+      tile_color = get_tile_color (self, &days[i]);
+      if (tile_color == *drawn)
+        continue;
+
+      get_tile_position (self, first_day + i, &x, &y);
+      draw_tile (cr, &color, x, y, tile_color);
+      gtk_widget_queue_draw_area (widget, x, y, TILE_SIZE, TILE_SIZE);
+      *drawn = tile_color;
+    }
+  cairo_destroy (cr);
+}
+
+/* Labels of the months and week days, then all tiles */
+static void
+render_surface (OgCalendarChart *self)
+{
+  static const gchar * const weekdays[] = { N_("Mon"), N_("Wed"), N_("Fri") };
+  GtkWidget *widget = (GtkWidget *) self;
+  GdkRGBA color;
+  cairo_t *cr;
+  gint previous_month = 0;
+  guint week;
+  guint i;
+
+  self->priv->surface = gdk_window_create_similar_surface (
+      gtk_widget_get_window (widget), CAIRO_CONTENT_COLOR_ALPHA,
+      MARGIN_LEFT + self->priv->n_weeks * TILE_PITCH + MARGIN_RIGHT,
+      MARGIN_TOP + DAYS_PER_WEEK * TILE_PITCH + MARGIN_BOTTOM);
+
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+      gtk_widget_get_state_flags (widget), &color);
+
+  cr = cairo_create (self->priv->surface);
+  gdk_cairo_set_source_rgba (cr, &color);
+
+  /* Over the first week of each month, years over January */
+  for (week = 0; week < self->priv->n_weeks; week++)
+    {
+      GDateTime *monday;
+      gint month;
+
+      monday = dup_date (self->priv->first_monday + week * DAYS_PER_WEEK);
+      month = g_date_time_get_month (monday);
+      if (month != previous_month && week < self->priv->n_weeks - 1)
+        {
+          gchar *text;
+
+          text = g_date_time_format (monday, month == 1 ? "%Y" : "%b");
+          og_chart_draw_text (widget, cr, text, MARGIN_LEFT + week * TILE_PITCH,
+              MARGIN_TOP - 4, 0, 1);
+          g_free (text);
+        }
+      previous_month = month;
+      g_date_time_unref (monday);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (weekdays); i++)
+    og_chart_draw_text (widget, cr, _(weekdays[i]), MARGIN_LEFT - 6,
+        MARGIN_TOP + (2 * i) * TILE_PITCH + TILE_SIZE / 2.0, 1, 0.5);
+
+  cairo_destroy (cr);
+
+  for (i = 0; i < self->priv->tile_colors->len; i++)
+    g_array_index (self->priv->tile_colors, guint32, i) = UNDRAWN_TILE;
+  update_tiles (self);
+}
+
+static gboolean
+draw (GtkWidget *widget,
+    cairo_t *cr)
+{
+  OgCalendarChart *self = (OgCalendarChart *) widget;
+  GdkRGBA color;
+
+  if (self->priv->calendar == NULL || self->priv->n_weeks == 0)
+    return FALSE;
+
+  if (self->priv->surface == NULL)
+    render_surface (self);
+
+  cairo_set_source_surface (cr, self->priv->surface, 0, 0);
+  cairo_paint (cr);
+
+  /* The title changes with the mode, without any tile being drawn again */
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+      gtk_widget_get_state_flags (widget), &color);
+  gdk_cairo_set_source_rgba (cr, &color);
+  og_chart_draw_text (widget, cr,
+      self->priv->mode == OG_CALENDAR_MODE_MEAN ?
+          _("Mean glucose per day") : _("Time in range per day"),
+      MARGIN_LEFT, MARGIN_TOP / 4, 0, 0.5);
+
+  return FALSE;
+}
+
+static gboolean
+query_tooltip (GtkWidget *widget,
+    gint x,
+    gint y,
+    gboolean keyboard_mode,
+    GtkTooltip *tooltip)
+{
+  OgCalendarChart *self = (OgCalendarChart *) widget;
+  const OgCalendarDay *days;
+  const OgCalendarDay *day;
+  GDateTime *date;
+  gchar *date_str;
+  gchar *text;
+  gint64 first_day;
+  gint64 number;
+  guint n_days;
+
+  if (self->priv->calendar == NULL || x < MARGIN_LEFT || y < MARGIN_TOP ||
+      y >= MARGIN_TOP + DAYS_PER_WEEK * TILE_PITCH)
+    return FALSE;
+
+  number = self->priv->first_monday +
+      (x - MARGIN_LEFT) / TILE_PITCH * DAYS_PER_WEEK +
+      (y - MARGIN_TOP) / TILE_PITCH;
+  days = og_calendar_get_days (self->priv->calendar, &first_day, &n_days);
+  if (number < first_day || number >= first_day + n_days)
+    return FALSE;
+
+  day = &days[number - first_day];
+  date = dup_date (number);
+  date_str = g_date_time_format (date, "%x");
+  if (day->n_values == 0)
+    text = g_strdup_printf (_("%s: no readings"), date_str);
+  else
+    text = g_strdup_printf (
+        _("%s: %u%% in range, mean %u mg/dl, %u readings"), date_str,
+        100 * (day->n_values - day->n_hypo - day->n_hyper) / day->n_values,
+        (guint) (day->sum / day->n_values), day->n_values);
+  gtk_tooltip_set_text (tooltip, text);
+
+  g_free (text);
+  g_free (date_str);
+  g_date_time_unref (date);
+
+  return TRUE;
+}
+
+static void
+style_updated (GtkWidget *widget)
+{
+  OgCalendarChart *self = (OgCalendarChart *) widget;
+
+  GTK_WIDGET_CLASS (og_calendar_chart_parent_class)->style_updated (widget);
+
+  /* Labels and empty tiles have the text color */
+  g_clear_pointer (&self->priv->surface, cairo_surface_destroy);
+  gtk_widget_queue_draw (widget);
+}
+
+static void
+unrealize (GtkWidget *widget)
+{
+  OgCalendarChart *self = (OgCalendarChart *) widget;
+
+  /* Similar to the window */
+  g_clear_pointer (&self->priv->surface, cairo_surface_destroy);
+
+  GTK_WIDGET_CLASS (og_calendar_chart_parent_class)->unrealize (widget);
+}
+
+static void
+og_calendar_chart_init (OgCalendarChart *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      OG_TYPE_CALENDAR_CHART, OgCalendarChartPrivate);
+
+  self->priv->tile_colors = g_array_new (FALSE, FALSE, sizeof (guint32));
+  gtk_widget_set_has_tooltip ((GtkWidget *) self, TRUE);
+}
+
+static void
+finalize (GObject *object)
+{
+  OgCalendarChart *self = (OgCalendarChart *) object;
+
+  g_clear_pointer (&self->priv->surface, cairo_surface_destroy);
+  g_array_unref (self->priv->tile_colors);
+
+  G_OBJECT_CLASS (og_calendar_chart_parent_class)->finalize (object);
+}
+
+static void
+og_calendar_chart_class_init (OgCalendarChartClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->finalize = finalize;
+  widget_class->draw = draw;
+  widget_class->query_tooltip = query_tooltip;
+  widget_class->style_updated = style_updated;
+  widget_class->unrealize = unrealize;
+
+  g_type_class_add_private (object_class, sizeof (OgCalendarChartPrivate));
+}
+
+GtkWidget *
+og_calendar_chart_new (void)
+{
+  return g_object_new (OG_TYPE_CALENDAR_CHART, NULL);
+}
+
+/* @calendar must outlive the chart, or until it is replaced. Only days whose
+ * tile changed color are drawn again, unless the history now spans other
+ * weeks. */
+void
+og_calendar_chart_set_calendar (OgCalendarChart *self,
+    const OgCalendar *calendar)
+{
+  gint64 first_day;
+  gint64 first_monday;
+  guint n_days;
+  guint n_weeks = 0;
+
+  g_return_if_fail (OG_IS_CALENDAR_CHART (self));
+  g_return_if_fail (calendar != NULL);
+
+  self->priv->calendar = calendar;
+
+  first_monday = self->priv->first_monday;
+  if (og_calendar_get_days (calendar, &first_day, &n_days) != NULL)
+    {
+      first_monday = first_day - get_weekday (first_day);
+      n_weeks = (first_day + n_days - 1 - first_monday) / DAYS_PER_WEEK + 1;
+    }
+
+  if (first_monday != self->priv->first_monday ||
+      n_weeks != self->priv->n_weeks)
+    {
+      self->priv->first_monday = first_monday;
+      self->priv->n_weeks = n_weeks;
+      g_array_set_size (self->priv->tile_colors, n_weeks * DAYS_PER_WEEK);
+      g_clear_pointer (&self->priv->surface, cairo_surface_destroy);
+
+      gtk_widget_set_size_request ((GtkWidget *) self,
+          MARGIN_LEFT + n_weeks * TILE_PITCH + MARGIN_RIGHT,
+          MARGIN_TOP + DAYS_PER_WEEK * TILE_PITCH + MARGIN_BOTTOM);
+      gtk_widget_queue_draw ((GtkWidget *) self);
+      return;
+    }
+
+  update_tiles (self);
+}
+
+void
+og_calendar_chart_set_mode (OgCalendarChart *self,
+    OgCalendarMode mode)
+{
+  g_return_if_fail (OG_IS_CALENDAR_CHART (self));
+
+  self->priv->mode = mode;
+
+  /* Days whose color is the same in both modes stay as they are */
+  if (self->priv->calendar != NULL)
+    update_tiles (self);
+  gtk_widget_queue_draw_area ((GtkWidget *) self, 0, 0,
+      gtk_widget_get_allocated_width ((GtkWidget *) self), MARGIN_TOP / 2);
+}
+
+/* Accepts NULL, before the chart is created */
+gsize
+og_calendar_chart_get_size (OgCalendarChart *self)
+{
+  gsize size;
+
+  if (self == NULL)
+    return 0;
+
+  size = sizeof (OgCalendarChartPrivate);
+  size += self->priv->tile_colors->len * sizeof (guint32);
+  if (self->priv->surface != NULL)
+    size += (MARGIN_LEFT + self->priv->n_weeks * TILE_PITCH + MARGIN_RIGHT) *
+        (MARGIN_TOP + DAYS_PER_WEEK * TILE_PITCH + MARGIN_BOTTOM) * 4;
+
+  return size;
+}
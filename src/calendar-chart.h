@@ -0,0 +1,59 @@
+#ifndef __OG_CALENDAR_CHART_H__
+#define __OG_CALENDAR_CHART_H__
+
+#include <gtk/gtk.h>
+
+#include "calendar.h"
+
+G_BEGIN_DECLS
+
+#define OG_TYPE_CALENDAR_CHART \
+    (og_calendar_chart_get_type ())
+#define OG_CALENDAR_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST ((obj), OG_TYPE_CALENDAR_CHART, \
+        OgCalendarChart))
+#define OG_CALENDAR_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST ((klass), OG_TYPE_CALENDAR_CHART, \
+        OgCalendarChartClass))
+#define OG_IS_CALENDAR_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE ((obj), OG_TYPE_CALENDAR_CHART))
+#define OG_IS_CALENDAR_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE ((klass), OG_TYPE_CALENDAR_CHART))
+#define OG_CALENDAR_CHART_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS ((obj), OG_TYPE_CALENDAR_CHART, \
+        OgCalendarChartClass))
+
+/* What the color of each day shows */
+typedef enum
+{
+  OG_CALENDAR_MODE_TIME_IN_RANGE,
+  OG_CALENDAR_MODE_MEAN,
+} OgCalendarMode;
+
+typedef struct _OgCalendarChart OgCalendarChart;
+typedef struct _OgCalendarChartClass OgCalendarChartClass;
+typedef struct _OgCalendarChartPrivate OgCalendarChartPrivate;
+
+struct _OgCalendarChart {
+  GtkDrawingArea parent;
+
+  OgCalendarChartPrivate *priv;
+};
+
+struct _OgCalendarChartClass {
+  GtkDrawingAreaClass parent_class;
+};
+
+GType og_calendar_chart_get_type (void) G_GNUC_CONST;
+
+GtkWidget *og_calendar_chart_new (void);
+
+void og_calendar_chart_set_calendar (OgCalendarChart *self,
+    const OgCalendar *calendar);
+void og_calendar_chart_set_mode (OgCalendarChart *self,
+    OgCalendarMode mode);
+gsize og_calendar_chart_get_size (OgCalendarChart *self);
+
+G_END_DECLS
+
+#endif /* __OG_CALENDAR_CHART_H__ */
@@ -0,0 +1,134 @@
+#include "config.h"
+
+#include "calendar.h"
+
+#include "indexed-array.h"
+
+struct _OgCalendar
+{
+  guint hypoglycemia;
+  guint hyperglycemia;
+
+  guint n_records;
+  /* GArray<OgCalendarDay> and number of its first day, which may be before
+   * the oldest one with readings */
+  GArray *days;
+  gint64 first_day;
+  gint64 oldest_day;
+};
+
+OgCalendar *
+og_calendar_new (guint hypoglycemia,
+    guint hyperglycemia)
+{
+  OgCalendar *self;
+
+  g_return_val_if_fail (hypoglycemia <= hyperglycemia, NULL);
+
+  self = g_slice_new0 (OgCalendar);
+  self->hypoglycemia = hypoglycemia;
+  self->hyperglycemia = hyperglycemia;
+  self->days = g_array_new (FALSE, TRUE, sizeof (OgCalendarDay));
+
+  return self;
+}
+
+void
+og_calendar_free (OgCalendar *self)
+{
+  if (self == NULL)
+    return;
+
+  g_array_unref (self->days);
+  g_slice_free (OgCalendar, self);
+}
+
+gsize
+og_calendar_get_size (const OgCalendar *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return sizeof (OgCalendar) + self->days->len * sizeof (OgCalendarDay);
+}
+
+gboolean
+og_calendar_has_thresholds (const OgCalendar *self,
+    guint hypoglycemia,
+    guint hyperglycemia)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return self->hypoglycemia == hypoglycemia &&
+      self->hyperglycemia == hyperglycemia;
+}
+
+void
+og_calendar_get_thresholds (const OgCalendar *self,
+    guint *hypoglycemia,
+    guint *hyperglycemia)
+{
+  g_return_if_fail (self != NULL);
+
+  if (hypoglycemia != NULL)
+    *hypoglycemia = self->hypoglycemia;
+  if (hyperglycemia != NULL)
+    *hyperglycemia = self->hyperglycemia;
+}
+
+guint
+og_calendar_get_n_records (const OgCalendar *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_records;
+}
+
+void
+og_calendar_add_record (OgCalendar *self,
+    const OgRecord *record)
+{
+  OgCalendarDay *day;
+  gint64 local_time;
+  gint64 number;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (record != NULL);
+
+  local_time = g_date_time_to_unix (record->datetime) +
+      g_date_time_get_utc_offset (record->datetime) / G_TIME_SPAN_SECOND;
+  number = og_div_floor (local_time, OG_SECONDS_PER_DAY);
+  if (self->n_records == 0 || number < self->oldest_day)
+    self->oldest_day = number;
+
+  day = og_indexed_array_get (self->days, &self->first_day, number);
+
+  day->n_values++;
+  day->n_hypo += record->glycemia < self->hypoglycemia;
+  day->n_hyper += record->glycemia >= self->hyperglycemia;
+  day->sum += record->glycemia;
+  self->n_records++;
+}
+
+/* All days from the oldest to the newest with readings, numbered from
+ * @first_day. Returns NULL if there are none. */
+const OgCalendarDay *
+og_calendar_get_days (const OgCalendar *self,
+    gint64 *first_day,
+    guint *n_days)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (n_days != NULL, NULL);
+
+  if (self->n_records == 0)
+    {
+      *n_days = 0;
+      return NULL;
+    }
+
+  if (first_day != NULL)
+    *first_day = self->oldest_day;
+  *n_days = self->days->len - (self->oldest_day - self->first_day);
+
+  return &g_array_index (self->days, OgCalendarDay,
+      self->oldest_day - self->first_day);
+}
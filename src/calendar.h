@@ -0,0 +1,47 @@
+#ifndef __OG_CALENDAR_H__
+#define __OG_CALENDAR_H__
+
+#include <glib.h>
+
+#include "record.h"
+
+G_BEGIN_DECLS
+
+/* Readings of a local day. Days without readings have n_values at 0. */
+typedef struct
+{
+  guint32 n_values;
+  /* Below hypoglycemia and at or above hyperglycemia */
+  guint32 n_hypo;
+  guint32 n_hyper;
+  guint64 sum;
+} OgCalendarDay;
+
+/* Per day summaries of the whole history, for the given thresholds. Days are
+ * numbered from the Unix epoch in local time, so records can be added in any
+ * order, each one updating a single day. */
+typedef struct _OgCalendar OgCalendar;
+
+OgCalendar *og_calendar_new (guint hypoglycemia,
+    guint hyperglycemia);
+void og_calendar_free (OgCalendar *self);
+gsize og_calendar_get_size (const OgCalendar *self);
+
+gboolean og_calendar_has_thresholds (const OgCalendar *self,
+    guint hypoglycemia,
+    guint hyperglycemia);
+void og_calendar_get_thresholds (const OgCalendar *self,
+    guint *hypoglycemia,
+    guint *hyperglycemia);
+
+guint og_calendar_get_n_records (const OgCalendar *self);
+void og_calendar_add_record (OgCalendar *self,
+    const OgRecord *record);
+
+const OgCalendarDay *og_calendar_get_days (const OgCalendar *self,
+    gint64 *first_day,
+    guint *n_days);
+
+G_END_DECLS
+
+#endif /* __OG_CALENDAR_H__ */
@@ -0,0 +1,542 @@
+#include "config.h"
+
+#include "chart-data.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "kernels.h"
+#include "trace.h"
+
+/* Smoothed modal day: mean of a sliding window, in minutes */
+#define SMOOTHING_WINDOW 60
+#define SMOOTHING_STEP 10
+
+/* Readings per batch sent to the modal day view, 64 KiB. Cancellation is
+ * checked between batches. */
+#define READINGS_PER_BATCH 16384
+
+/* The modal day shows the density of readings above that many of them,
+ * unless overridden with OPENGLUCOSE_DENSITY_THRESHOLD */
+#define DEFAULT_DENSITY_THRESHOLD 5000
+
+struct _OgChartData
+{
+  OgChartDataFlags flags;
+  guint meal_tag;
+  guint modal_day_width;
+  guint hypoglycemia;
+  guint hyperglycemia;
+
+  /* Readings of the span, grouped by meal tag: those tagged i are in
+   * [offsets[i], offsets[i + 1]). They are only copied for the modal day. */
+  GArray *glycemia;
+  GArray *minutes;
+  guint offsets[OG_N_MEAL_TAGS + 1];
+
+  /* Readings of the span by range, whatever their meal tag */
+  guint n_hypo;
+  guint n_good;
+  guint n_hyper;
+
+  OgModalDay *modal_day;
+  OgAgp *agp;
+
+  /* Built in the worker */
+  GPtrArray *modal_day_data;
+  gchar *average_data;
+};
+
+OgChartData *
+og_chart_data_new (OgStats *stats,
+    OgChartDataFlags flags,
+    OgTimeSpan span,
+    guint meal_tag,
+    guint modal_day_width,
+    guint hypoglycemia,
+    guint hyperglycemia)
+{
+  OgChartData *self;
+  OgTimeSpan class;
+  guint i;
+
+  g_return_val_if_fail (stats != NULL, NULL);
+  g_return_val_if_fail (span < OG_N_TIME_SPANS, NULL);
+  g_return_val_if_fail (meal_tag <= OG_MEAL_TAG_ANY, NULL);
+
+  og_trace_begin ("chart-data-new");
+
+  self = g_slice_new0 (OgChartData);
+  self->flags = flags;
+  self->meal_tag = meal_tag;
+  self->modal_day_width = modal_day_width;
+  self->hypoglycemia = hypoglycemia;
+  self->hyperglycemia = hyperglycemia;
+
+  self->glycemia = g_array_new (FALSE, FALSE, sizeof (guint16));
+  self->minutes = g_array_new (FALSE, FALSE, sizeof (guint16));
+  for (i = 0; i < OG_N_MEAL_TAGS; i++)
+    {
+      self->offsets[i] = self->glycemia->len;
+      if (!(flags & OG_CHART_DATA_MODAL_DAY))
+        continue;
+
+      for (class = OG_TIME_SPAN_1W; class <= span; class++)
+        {
+          const guint16 *glycemia;
+          const guint16 *minutes;
+          guint n_readings;
+
+          glycemia = og_stats_get_readings (stats, class, i, &minutes,
+              &n_readings);
+          g_array_append_vals (self->glycemia, glycemia, n_readings);
+          g_array_append_vals (self->minutes, minutes, n_readings);
+        }
+    }
+  self->offsets[OG_N_MEAL_TAGS] = self->glycemia->len;
+
+  /* Those are cheap, their cost does not depend on the number of readings */
+  if (flags & OG_CHART_DATA_AVERAGE)
+    og_stats_classify (stats, span, hypoglycemia, hyperglycemia,
+        &self->n_hypo, &self->n_good, &self->n_hyper);
+  if (flags & OG_CHART_DATA_MODAL_DAY)
+    {
+      self->modal_day = g_memdup (og_stats_get_modal_day (stats, span,
+              meal_tag), sizeof (OgModalDay));
+      self->agp = g_new (OgAgp, 1);
+      og_stats_compute_agp (stats, span, self->agp);
+    }
+
+  og_trace_end ("chart-data-new");
+
+  return self;
+}
+
+void
+og_chart_data_free (OgChartData *self)
+{
+  if (self == NULL)
+    return;
+
+  g_array_unref (self->glycemia);
+  g_array_unref (self->minutes);
+  g_free (self->modal_day);
+  g_free (self->agp);
+  g_clear_pointer (&self->modal_day_data, g_ptr_array_unref);
+  g_free (self->average_data);
+  g_slice_free (OgChartData, self);
+}
+
+gsize
+og_chart_data_get_size (const OgChartData *self)
+{
+  gsize size;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  size = sizeof (OgChartData);
+  size += (self->glycemia->len + self->minutes->len) * sizeof (guint16);
+  if (self->modal_day != NULL)
+    size += sizeof (OgModalDay);
+  if (self->agp != NULL)
+    size += sizeof (OgAgp);
+
+  return size;
+}
+
+OgChartDataFlags
+og_chart_data_get_flags (const OgChartData *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->flags;
+}
+
+guint
+og_chart_data_get_hypoglycemia (const OgChartData *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->hypoglycemia;
+}
+
+guint
+og_chart_data_get_hyperglycemia (const OgChartData *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->hyperglycemia;
+}
+
+/* Readings of the modal day scatter, in the selected meal tag */
+const guint16 *
+og_chart_data_get_readings (const OgChartData *self,
+    const guint16 **minutes,
+    guint *n_readings)
+{
+  guint start, end;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->flags & OG_CHART_DATA_MODAL_DAY, NULL);
+
+  if (self->meal_tag == OG_MEAL_TAG_ANY)
+    {
+      start = 0;
+      end = self->offsets[OG_N_MEAL_TAGS];
+    }
+  else
+    {
+      start = self->offsets[self->meal_tag];
+      end = self->offsets[self->meal_tag + 1];
+    }
+
+  if (minutes != NULL)
+    *minutes = (const guint16 *) self->minutes->data + start;
+  if (n_readings != NULL)
+    *n_readings = end - start;
+
+  return (const guint16 *) self->glycemia->data + start;
+}
+
+/* Returns the modal day mean as a GArray<OgChartPoint>, each point at the
+ * middle of its window */
+GArray *
+og_chart_data_dup_mean (const OgChartData *self)
+{
+  GArray *points;
+  guint window;
+  guint step;
+  guint minute;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->flags & OG_CHART_DATA_MODAL_DAY, NULL);
+
+  if (self->modal_day_width == 0)
+    {
+      window = SMOOTHING_WINDOW;
+      step = SMOOTHING_STEP;
+    }
+  else
+    {
+      window = step = self->modal_day_width;
+    }
+
+  points = g_array_sized_new (FALSE, FALSE, sizeof (OgChartPoint),
+      OG_MINUTES_PER_DAY / step + 1);
+  for (minute = 0; minute < OG_MINUTES_PER_DAY; minute += step)
+    {
+      OgChartPoint point;
+      gint start;
+      gdouble mean;
+
+      /* Smoothed windows are centered on the minute, buckets start there */
+      start = minute;
+      if (self->modal_day_width == 0)
+        start -= window / 2;
+
+      if (og_modal_day_get_window (self->modal_day, start, start + window,
+              &mean) == 0)
+        continue;
+
+      point.seconds = start * 60 + window * 30;
+      point.value = (guint) (mean + 0.5);
+      g_array_append_val (points, point);
+    }
+
+  return points;
+}
+
+const OgAgp *
+og_chart_data_get_agp (const OgChartData *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->flags & OG_CHART_DATA_MODAL_DAY, NULL);
+
+  return self->agp;
+}
+
+static guint
+get_density_threshold (void)
+{
+  static guint threshold = 0;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      const gchar *value = g_getenv ("OPENGLUCOSE_DENSITY_THRESHOLD");
+
+      threshold = DEFAULT_DENSITY_THRESHOLD;
+      if (value != NULL)
+        threshold = g_ascii_strtoull (value, NULL, 10);
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return threshold;
+}
+
+/* Bins the readings of the modal day scatter in a single pass, if there are
+ * more than the density threshold. Returns FALSE, leaving @density untouched,
+ * if they should be plotted one by one. */
+gboolean
+og_chart_data_compute_density (const OgChartData *self,
+    OgDensity *density)
+{
+  const guint16 *glycemia;
+  const guint16 *minutes;
+  guint n_readings;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (self->flags & OG_CHART_DATA_MODAL_DAY, FALSE);
+  g_return_val_if_fail (density != NULL, FALSE);
+
+  glycemia = og_chart_data_get_readings (self, &minutes, &n_readings);
+  if (n_readings <= get_density_threshold ())
+    return FALSE;
+
+  og_trace_begin ("compute-density");
+
+  memset (density, 0, sizeof (OgDensity));
+  for (i = 0; i < n_readings; i++)
+    {
+      guint row = MIN (glycemia[i], OG_GLYCEMIA_MAX) / OG_DENSITY_GLYCEMIA;
+      guint column = MIN (minutes[i], OG_MINUTES_PER_DAY - 1) /
+          OG_DENSITY_MINUTES;
+      guint32 count = ++density->counts[row][column];
+
+      density->max_count = MAX (density->max_count, count);
+    }
+
+  og_trace_end ("compute-density");
+
+  return TRUE;
+}
+
+/* Counts all readings of the span, whatever their meal tag */
+void
+og_chart_data_classify (const OgChartData *self,
+    guint *n_hypo,
+    guint *n_good,
+    guint *n_hyper)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->flags & OG_CHART_DATA_AVERAGE);
+
+  if (n_hypo != NULL)
+    *n_hypo = self->n_hypo;
+  if (n_good != NULL)
+    *n_good = self->n_good;
+  if (n_hyper != NULL)
+    *n_hyper = self->n_hyper;
+}
+
+/* Packed series of the modal day chart as a GPtrArray<GBytes> of chunks, see
+ * build_modal_day(). NULL until built or if not requested. */
+GPtrArray *
+og_chart_data_get_modal_day (const OgChartData *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->modal_day_data;
+}
+
+/* NULL until built or if not requested */
+const gchar *
+og_chart_data_get_average (const OgChartData *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->average_data;
+}
+
+/* The modal day is sent to its view as chunks of packed arrays in host byte
+ * order, which the page maps onto typed arrays without parsing anything. The
+ * first chunk is small and has all the page needs to plot the chart, then
+ * come batches of readings the page draws progressively:
+ *
+ *   guint32 n_readings, n_batches, max_glycemia, n_mean, n_agp
+ *   guint32 density_columns, density_rows, density_glycemia, density_max
+ *   guint32 mean[n_mean][2]: seconds, glycemia
+ *   guint32 agp[n_agp][1 + OG_AGP_N_PERCENTILES]: seconds, percentiles...
+ *
+ *   guint16 readings[READINGS_PER_BATCH or less][2]: minutes, glycemia
+ *   ...
+ *
+ * Above the density threshold, density_max is not 0 and there are no batches
+ * of readings but a single chunk with their density, whatever their number:
+ *
+ *   guint32 counts[density_rows][density_columns], lowest glycemia first
+ *
+ * Keep in sync with modal-day-chart.js. */
+static gboolean
+build_modal_day (OgChartData *self,
+    GCancellable *cancellable)
+{
+  const guint16 *glycemia;
+  const guint16 *minutes;
+  const OgChartPoint *points;
+  GPtrArray *chunks;
+  GArray *mean;
+  OgDensity *density;
+  guint32 *p32;
+  gpointer buffer;
+  gsize size;
+  guint n_readings;
+  guint n_batches;
+  guint16 min = G_MAXUINT16;
+  guint16 max = 0;
+  guint n_agp = 0;
+  guint i, j;
+
+  glycemia = og_chart_data_get_readings (self, &minutes, &n_readings);
+  og_kernels_min_max (glycemia, n_readings, &min, &max);
+  density = g_new (OgDensity, 1);
+  if (og_chart_data_compute_density (self, density))
+    {
+      n_batches = 0;
+    }
+  else
+    {
+      g_clear_pointer (&density, g_free);
+      n_batches = (n_readings + READINGS_PER_BATCH - 1) / READINGS_PER_BATCH;
+    }
+  mean = og_chart_data_dup_mean (self);
+  points = (const OgChartPoint *) mean->data;
+  for (i = 0; i < OG_AGP_N_BINS; i++)
+    {
+      if (self->agp->n_values[i] > 0)
+        n_agp++;
+    }
+
+  chunks = g_ptr_array_new_full (2 + n_batches,
+      (GDestroyNotify) g_bytes_unref);
+
+  size = (9 + mean->len * 2 + n_agp * (1 + OG_AGP_N_PERCENTILES)) *
+      sizeof (guint32);
+  p32 = buffer = g_malloc (size);
+  *p32++ = n_readings;
+  *p32++ = n_batches;
+  *p32++ = max;
+  *p32++ = mean->len;
+  *p32++ = n_agp;
+  *p32++ = OG_DENSITY_COLUMNS;
+  *p32++ = OG_DENSITY_ROWS;
+  *p32++ = OG_DENSITY_GLYCEMIA;
+  *p32++ = density != NULL ? density->max_count : 0;
+
+  for (i = 0; i < mean->len; i++)
+    {
+      *p32++ = points[i].seconds;
+      *p32++ = points[i].value;
+    }
+  g_array_unref (mean);
+
+  /* Points are at the middle of each bin */
+  for (i = 0; i < OG_AGP_N_BINS; i++)
+    {
+      if (self->agp->n_values[i] == 0)
+        continue;
+
+      *p32++ = (i * 15 + 7) * 60 + 30;
+      for (j = 0; j < OG_AGP_N_PERCENTILES; j++)
+        *p32++ = (guint32) (self->agp->percentiles[i][j] + 0.5);
+    }
+  g_ptr_array_add (chunks, g_bytes_new_take (buffer, size));
+
+  if (density != NULL)
+    {
+      g_ptr_array_add (chunks, g_bytes_new_with_free_func (density->counts,
+              sizeof (density->counts), g_free, density));
+    }
+
+  for (i = 0; i < n_batches * READINGS_PER_BATCH; i += READINGS_PER_BATCH)
+    {
+      guint n = MIN (READINGS_PER_BATCH, n_readings - i);
+
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          g_ptr_array_unref (chunks);
+          return FALSE;
+        }
+
+      size = n * 2 * sizeof (guint16);
+      buffer = g_malloc (size);
+      og_kernels_interleave (minutes + i, glycemia + i, n, buffer);
+      g_ptr_array_add (chunks, g_bytes_new_take (buffer, size));
+    }
+
+  self->modal_day_data = chunks;
+
+  return TRUE;
+}
+
+static void
+build_average (OgChartData *self)
+{
+  guint n_hypo, n_good, n_hyper;
+
+  og_chart_data_classify (self, &n_hypo, &n_good, &n_hyper);
+  self->average_data = g_strdup_printf ("[['%s',%u],['%s',%u],['%s',%u]]",
+      _("Hypoglycemia"), n_hypo,
+      _("Good"), n_good,
+      _("Hyperglycemia"), n_hyper);
+}
+
+static void
+build_thread_func (GTask *task,
+    gpointer source_object,
+    gpointer task_data,
+    GCancellable *cancellable)
+{
+  OgChartData *self = task_data;
+
+  og_trace_begin ("chart-data-build");
+
+  if (self->flags & OG_CHART_DATA_AVERAGE)
+    build_average (self);
+
+  if ((self->flags & OG_CHART_DATA_MODAL_DAY) &&
+      !build_modal_day (self, cancellable))
+    {
+      og_trace_end ("chart-data-build");
+      og_chart_data_free (self);
+      g_task_return_error_if_cancelled (task);
+      return;
+    }
+
+  og_trace_end ("chart-data-build");
+
+  /* The task data is not owned by the task, the result takes it */
+  g_task_return_pointer (task, self, (GDestroyNotify) og_chart_data_free);
+}
+
+/* Takes ownership of @self. If @cancellable is cancelled, the callback gets a
+ * G_IO_ERROR_CANCELLED error even if the data was already built, so only the
+ * latest request is delivered when cancelling previous ones. */
+void
+og_chart_data_build_async (OgChartData *self,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (self != NULL);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, og_chart_data_build_async);
+  /* Owned by the thread, which frees it or returns it */
+  g_task_set_task_data (task, self, NULL);
+  g_task_run_in_thread (task, build_thread_func);
+  g_object_unref (task);
+}
+
+OgChartData *
+og_chart_data_build_finish (GAsyncResult *result,
+    GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,81 @@
+#ifndef __OG_CHART_DATA_H__
+#define __OG_CHART_DATA_H__
+
+#include <gio/gio.h>
+
+#include "stats.h"
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  OG_CHART_DATA_MODAL_DAY = 1 << 0,
+  OG_CHART_DATA_AVERAGE = 1 << 1,
+} OgChartDataFlags;
+
+/* A point of a series plotted over the time of the day */
+typedef struct
+{
+  guint seconds;
+  guint value;
+} OgChartPoint;
+
+/* Modal day readings counted per time of the day and glycemia bin, drawn
+ * instead of the readings themselves when there are too many of them */
+#define OG_DENSITY_MINUTES 10
+#define OG_DENSITY_COLUMNS (OG_MINUTES_PER_DAY / OG_DENSITY_MINUTES)
+#define OG_DENSITY_GLYCEMIA 5
+#define OG_DENSITY_ROWS (OG_GLYCEMIA_MAX / OG_DENSITY_GLYCEMIA + 1)
+
+typedef struct
+{
+  /* Row 0 has the lowest glycemia */
+  guint32 counts[OG_DENSITY_ROWS][OG_DENSITY_COLUMNS];
+  guint32 max_count;
+} OgDensity;
+
+/* Data of the charts. Readings are copied from the stats when it is created,
+ * on the main thread, so data for the chart views can then be built in a
+ * worker thread while the stats keep changing. Native charts draw from it
+ * directly. */
+typedef struct _OgChartData OgChartData;
+
+OgChartData *og_chart_data_new (OgStats *stats,
+    OgChartDataFlags flags,
+    OgTimeSpan span,
+    guint meal_tag,
+    guint modal_day_width,
+    guint hypoglycemia,
+    guint hyperglycemia);
+void og_chart_data_free (OgChartData *self);
+gsize og_chart_data_get_size (const OgChartData *self);
+
+OgChartDataFlags og_chart_data_get_flags (const OgChartData *self);
+guint og_chart_data_get_hypoglycemia (const OgChartData *self);
+guint og_chart_data_get_hyperglycemia (const OgChartData *self);
+
+const guint16 *og_chart_data_get_readings (const OgChartData *self,
+    const guint16 **minutes,
+    guint *n_readings);
+GArray *og_chart_data_dup_mean (const OgChartData *self);
+const OgAgp *og_chart_data_get_agp (const OgChartData *self);
+gboolean og_chart_data_compute_density (const OgChartData *self,
+    OgDensity *density);
+void og_chart_data_classify (const OgChartData *self,
+    guint *n_hypo,
+    guint *n_good,
+    guint *n_hyper);
+
+GPtrArray *og_chart_data_get_modal_day (const OgChartData *self);
+const gchar *og_chart_data_get_average (const OgChartData *self);
+
+void og_chart_data_build_async (OgChartData *self,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+OgChartData *og_chart_data_build_finish (GAsyncResult *result,
+    GError **error);
+
+G_END_DECLS
+
+#endif /* __OG_CHART_DATA_H__ */
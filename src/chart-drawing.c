@@ -0,0 +1,72 @@
+#include "config.h"
+
+#include "chart-drawing.h"
+
+gdouble
+og_chart_area_get_x (const OgChartArea *area,
+    gint64 time)
+{
+  return area->x + area->width * (time - area->start) /
+      (gdouble) (area->end - area->start);
+}
+
+/* Values above the top are drawn at the top */
+gdouble
+og_chart_area_get_y (const OgChartArea *area,
+    guint value)
+{
+  value = MIN (value, area->max_value);
+
+  return area->y + area->height - area->height * value / area->max_value;
+}
+
+/* @xalign and @yalign are the position of (@x, @y) within the text, from 0
+ * for left or top to 1 for right or bottom */
+void
+og_chart_draw_text (GtkWidget *widget,
+    cairo_t *cr,
+    const gchar *text,
+    gdouble x,
+    gdouble y,
+    gdouble xalign,
+    gdouble yalign)
+{
+  PangoLayout *layout;
+  gint width, height;
+
+  layout = gtk_widget_create_pango_layout (widget, text);
+  pango_layout_get_pixel_size (layout, &width, &height);
+  cairo_move_to (cr, x - width * xalign, y - height * yalign);
+  pango_cairo_show_layout (cr, layout);
+  g_object_unref (layout);
+}
+
+static void
+draw_band (cairo_t *cr,
+    const OgChartArea *area,
+    guint min,
+    guint max,
+    gdouble red,
+    gdouble green,
+    gdouble blue)
+{
+  gdouble top = og_chart_area_get_y (area, max);
+
+  cairo_set_source_rgba (cr, red, green, blue, 0.3);
+  cairo_rectangle (cr, area->x, top, area->width,
+      og_chart_area_get_y (area, min) - top);
+  cairo_fill (cr);
+}
+
+/* Hypoglycemia in blue, in range in green and hyperglycemia in red, across
+ * the whole width */
+void
+og_chart_draw_threshold_bands (cairo_t *cr,
+    const OgChartArea *area,
+    guint hypoglycemia,
+    guint hyperglycemia)
+{
+  draw_band (cr, area, 0, hypoglycemia, 0, 0, 1);
+  draw_band (cr, area, hypoglycemia, hyperglycemia, 0, 1, 0);
+  draw_band (cr, area, hyperglycemia, area->max_value, 1, 0, 0);
+}
@@ -0,0 +1,41 @@
+#ifndef __OG_CHART_DRAWING_H__
+#define __OG_CHART_DRAWING_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* Plot area of the native charts, in pixels. Times, in seconds, go from
+ * @start on the left to @end on the right, and glycemia from 0 at the bottom
+ * to @max_value at the top. */
+typedef struct
+{
+  gdouble x;
+  gdouble y;
+  gdouble width;
+  gdouble height;
+  gint64 start;
+  gint64 end;
+  guint max_value;
+} OgChartArea;
+
+gdouble og_chart_area_get_x (const OgChartArea *area,
+    gint64 time);
+gdouble og_chart_area_get_y (const OgChartArea *area,
+    guint value);
+
+void og_chart_draw_text (GtkWidget *widget,
+    cairo_t *cr,
+    const gchar *text,
+    gdouble x,
+    gdouble y,
+    gdouble xalign,
+    gdouble yalign);
+void og_chart_draw_threshold_bands (cairo_t *cr,
+    const OgChartArea *area,
+    guint hypoglycemia,
+    guint hyperglycemia);
+
+G_END_DECLS
+
+#endif /* __OG_CHART_DRAWING_H__ */
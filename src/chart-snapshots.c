@@ -0,0 +1,504 @@
+#include "config.h"
+
+#include "chart-snapshots.h"
+
+#include <string.h>
+
+#include "trace.h"
+
+/* Snapshots kept in memory, the oldest ones are dropped first */
+#define MAX_MEMORY_SNAPSHOTS 16
+/* Snapshots kept on disk per device, the least recently saved ones are
+ * deleted first */
+#define MAX_DISK_SNAPSHOTS 8
+
+#define SUFFIX ".png"
+
+static struct
+{
+  /* Owned key -> GBytes of the PNG image */
+  GHashTable *images;
+  /* Owned keys, oldest first */
+  GQueue keys;
+  /* Owned paths of the directories loaded or being loaded */
+  GHashTable *loaded_dirs;
+} snapshots;
+
+typedef struct
+{
+  gchar *key;
+  GBytes *image;
+} Snapshot;
+
+static void
+snapshot_free (Snapshot *snapshot)
+{
+  g_free (snapshot->key);
+  g_bytes_unref (snapshot->image);
+  g_slice_free (Snapshot, snapshot);
+}
+
+/* Each device has its own directory, named after a checksum of its serial
+ * number so it is a valid file name */
+static GFile *
+dup_dir (const gchar *serial_number)
+{
+  GFile *dir;
+  gchar *checksum;
+  gchar *path;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, serial_number,
+      -1);
+  path = g_build_filename (g_get_user_cache_dir (), "openglucose",
+      "snapshots", checksum, NULL);
+  dir = g_file_new_for_path (path);
+  g_free (path);
+  g_free (checksum);
+
+  return dir;
+}
+
+static void
+add_image (const gchar *key,
+    GBytes *image)
+{
+  if (snapshots.images == NULL)
+    snapshots.images = g_hash_table_new_full (g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) g_bytes_unref);
+
+  /* An existing key keeps its place, and its owned string */
+  if (g_hash_table_contains (snapshots.images, key))
+    {
+      g_hash_table_insert (snapshots.images, (gpointer) key,
+          g_bytes_ref (image));
+      return;
+    }
+
+  g_queue_push_tail (&snapshots.keys, g_strdup (key));
+  g_hash_table_insert (snapshots.images, g_queue_peek_tail (&snapshots.keys),
+      g_bytes_ref (image));
+
+  while (g_queue_get_length (&snapshots.keys) > MAX_MEMORY_SNAPSHOTS)
+    {
+      gchar *oldest = g_queue_pop_head (&snapshots.keys);
+
+      g_hash_table_remove (snapshots.images, oldest);
+      g_free (oldest);
+    }
+}
+
+/* Newest first */
+static gint
+compare_modified (gconstpointer a,
+    gconstpointer b)
+{
+  GFileInfo *ia = *(GFileInfo **) a;
+  GFileInfo *ib = *(GFileInfo **) b;
+  guint64 ta, tb;
+
+  ta = g_file_info_get_attribute_uint64 (ia, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  tb = g_file_info_get_attribute_uint64 (ib, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+/* Deletes all but the MAX_DISK_SNAPSHOTS newest snapshots of @dir. Returns the
+ * GFileInfo of those kept, newest first, or NULL on error. Runs in a worker
+ * thread. */
+static GPtrArray *
+prune_dir (GFile *dir,
+    GCancellable *cancellable,
+    GError **error)
+{
+  GFileEnumerator *enumerator;
+  GFileInfo *info;
+  GPtrArray *infos;
+  GError *local_error = NULL;
+  guint i;
+
+  infos = g_ptr_array_new_with_free_func (g_object_unref);
+
+  enumerator = g_file_enumerate_children (dir,
+      G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+      G_FILE_QUERY_INFO_NONE, cancellable, &local_error);
+  if (enumerator == NULL)
+    {
+      /* Nothing saved yet */
+      if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          g_clear_error (&local_error);
+          return infos;
+        }
+
+      g_propagate_error (error, local_error);
+      g_ptr_array_unref (infos);
+      return NULL;
+    }
+
+  while ((info = g_file_enumerator_next_file (enumerator, cancellable,
+              &local_error)) != NULL)
+    {
+      /* Skips the temporary files of snapshots being saved */
+      if (g_str_has_suffix (g_file_info_get_name (info), SUFFIX))
+        g_ptr_array_add (infos, info);
+      else
+        g_object_unref (info);
+    }
+  g_object_unref (enumerator);
+
+  if (local_error != NULL)
+    {
+      g_propagate_error (error, local_error);
+      g_ptr_array_unref (infos);
+      return NULL;
+    }
+
+  g_ptr_array_sort (infos, compare_modified);
+
+  for (i = MAX_DISK_SNAPSHOTS; i < infos->len; i++)
+    {
+      GFile *file;
+
+      file = g_file_get_child (dir,
+          g_file_info_get_name (g_ptr_array_index (infos, i)));
+      /* Another save may have deleted it already */
+      if (!g_file_delete (file, cancellable, &local_error) &&
+          !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        g_warning ("Error deleting chart snapshot: %s", local_error->message);
+      g_clear_error (&local_error);
+      g_object_unref (file);
+    }
+  if (infos->len > MAX_DISK_SNAPSHOTS)
+    g_ptr_array_set_size (infos, MAX_DISK_SNAPSHOTS);
+
+  return infos;
+}
+
+static void
+load_thread_func (GTask *task,
+    gpointer source_object,
+    gpointer task_data,
+    GCancellable *cancellable)
+{
+  GFile *dir = task_data;
+  GPtrArray *infos;
+  GPtrArray *loaded;
+  GError *error = NULL;
+  guint i;
+
+  og_trace_begin ("snapshots-load");
+
+  infos = prune_dir (dir, cancellable, &error);
+  if (infos == NULL)
+    {
+      og_trace_end ("snapshots-load");
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Oldest first, the order they are added to memory in */
+  loaded = g_ptr_array_new_with_free_func ((GDestroyNotify) snapshot_free);
+  for (i = infos->len; i > 0 && !g_cancellable_is_cancelled (cancellable);
+      i--)
+    {
+      const gchar *name;
+      GFile *file;
+      gchar *contents;
+      gsize length;
+
+      name = g_file_info_get_name (g_ptr_array_index (infos, i - 1));
+      file = g_file_get_child (dir, name);
+      if (g_file_load_contents (file, cancellable, &contents, &length, NULL,
+              &error))
+        {
+          Snapshot *snapshot = g_slice_new (Snapshot);
+
+          snapshot->key = g_strndup (name, strlen (name) - strlen (SUFFIX));
+          snapshot->image = g_bytes_new_take (contents, length);
+          g_ptr_array_add (loaded, snapshot);
+        }
+      else
+        {
+          if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("Error loading chart snapshot %s: %s", name,
+                error->message);
+          g_clear_error (&error);
+        }
+      g_object_unref (file);
+    }
+  g_ptr_array_unref (infos);
+
+  og_trace_end ("snapshots-load");
+
+  g_task_return_pointer (task, loaded, (GDestroyNotify) g_ptr_array_unref);
+}
+
+/* Loads the snapshots saved for the device @serial_number into memory, in a
+ * worker thread. It is done once per device, later calls complete right
+ * away. */
+void
+og_chart_snapshots_load_async (const gchar *serial_number,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  GTask *task;
+  GFile *dir;
+
+  g_return_if_fail (serial_number != NULL);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, og_chart_snapshots_load_async);
+
+  if (snapshots.loaded_dirs == NULL)
+    snapshots.loaded_dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, NULL);
+
+  dir = dup_dir (serial_number);
+  g_task_set_task_data (task, dir, g_object_unref);
+
+  if (g_hash_table_add (snapshots.loaded_dirs, g_file_get_path (dir)))
+    g_task_run_in_thread (task, load_thread_func);
+  else
+    g_task_return_pointer (task, NULL, NULL);
+
+  g_object_unref (task);
+}
+
+/* Adds the loaded snapshots to memory. Snapshots stored meanwhile are newer,
+ * they are kept. */
+gboolean
+og_chart_snapshots_load_finish (GAsyncResult *result,
+    GError **error)
+{
+  GTask *task;
+  GPtrArray *loaded;
+  GError *local_error = NULL;
+  guint i;
+
+  g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+  task = G_TASK (result);
+  loaded = g_task_propagate_pointer (task, &local_error);
+  if (local_error != NULL)
+    {
+      /* So it can be loaded again */
+      gchar *path = g_file_get_path (g_task_get_task_data (task));
+
+      if (snapshots.loaded_dirs != NULL)
+        g_hash_table_remove (snapshots.loaded_dirs, path);
+      g_free (path);
+
+      g_propagate_error (error, local_error);
+      return FALSE;
+    }
+
+  if (loaded == NULL)
+    return TRUE;
+
+  for (i = 0; i < loaded->len; i++)
+    {
+      Snapshot *snapshot = g_ptr_array_index (loaded, i);
+
+      if (snapshots.images == NULL ||
+          !g_hash_table_contains (snapshots.images, snapshot->key))
+        add_image (snapshot->key, snapshot->image);
+    }
+  g_ptr_array_unref (loaded);
+
+  return TRUE;
+}
+
+typedef struct
+{
+  const guchar *data;
+  gsize size;
+  gsize offset;
+} ReadClosure;
+
+static cairo_status_t
+read_cb (gpointer user_data,
+    guchar *data,
+    guint length)
+{
+  ReadClosure *closure = user_data;
+
+  if (length > closure->size - closure->offset)
+    return CAIRO_STATUS_READ_ERROR;
+
+  memcpy (data, closure->data + closure->offset, length);
+  closure->offset += length;
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+write_cb (gpointer user_data,
+    const guchar *data,
+    guint length)
+{
+  g_byte_array_append (user_data, data, length);
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+/* Returns the snapshot stored under @key, or NULL if there is none in memory.
+ * Saved ones are only there once their device is loaded. */
+cairo_surface_t *
+og_chart_snapshots_lookup (const gchar *key)
+{
+  cairo_surface_t *surface;
+  ReadClosure closure = { NULL, };
+  GBytes *image = NULL;
+
+  g_return_val_if_fail (key != NULL, NULL);
+
+  if (snapshots.images != NULL)
+    image = g_hash_table_lookup (snapshots.images, key);
+  if (image == NULL)
+    return NULL;
+
+  og_trace_begin ("snapshot-lookup");
+
+  closure.data = g_bytes_get_data (image, &closure.size);
+  surface = cairo_image_surface_create_from_png_stream (read_cb, &closure);
+
+  og_trace_end ("snapshot-lookup");
+
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+      g_warning ("Error decoding chart snapshot %s: %s", key,
+          cairo_status_to_string (cairo_surface_status (surface)));
+      cairo_surface_destroy (surface);
+      return NULL;
+    }
+
+  return surface;
+}
+
+typedef struct
+{
+  GFile *file;
+  GBytes *image;
+} SaveData;
+
+static void
+save_data_free (SaveData *data)
+{
+  g_object_unref (data->file);
+  g_bytes_unref (data->image);
+  g_slice_free (SaveData, data);
+}
+
+static void
+save_thread_func (GTask *task,
+    gpointer source_object,
+    gpointer task_data,
+    GCancellable *cancellable)
+{
+  SaveData *data = task_data;
+  GFile *dir;
+  GPtrArray *infos = NULL;
+  GError *error = NULL;
+
+  og_trace_begin ("snapshot-save");
+
+  dir = g_file_get_parent (data->file);
+  if (!g_file_make_directory_with_parents (dir, cancellable, &error) &&
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+    g_clear_error (&error);
+
+  if (error == NULL &&
+      g_file_replace_contents (data->file,
+          g_bytes_get_data (data->image, NULL),
+          g_bytes_get_size (data->image), NULL, FALSE,
+          G_FILE_CREATE_REPLACE_DESTINATION, NULL, cancellable, &error))
+    infos = prune_dir (dir, cancellable, &error);
+
+  g_clear_pointer (&infos, g_ptr_array_unref);
+  g_object_unref (dir);
+
+  og_trace_end ("snapshot-save");
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+save_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  GError *error = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_warning ("Error saving chart snapshot: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+/* Encodes @surface as PNG and keeps it in memory. It is saved in the
+ * directory of the device @serial_number in the background, which is then
+ * pruned to its MAX_DISK_SNAPSHOTS newest snapshots. */
+void
+og_chart_snapshots_store (const gchar *serial_number,
+    const gchar *key,
+    cairo_surface_t *surface)
+{
+  GByteArray *buffer;
+  GBytes *image;
+  GFile *dir;
+  GTask *task;
+  SaveData *data;
+  gchar *basename;
+  cairo_status_t status;
+
+  g_return_if_fail (serial_number != NULL);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (surface != NULL);
+
+  og_trace_begin ("snapshot-store");
+
+  buffer = g_byte_array_new ();
+  status = cairo_surface_write_to_png_stream (surface, write_cb, buffer);
+  image = g_byte_array_free_to_bytes (buffer);
+  if (status != CAIRO_STATUS_SUCCESS)
+    {
+      g_warning ("Error encoding chart snapshot %s: %s", key,
+          cairo_status_to_string (status));
+      g_bytes_unref (image);
+      og_trace_end ("snapshot-store");
+      return;
+    }
+
+  add_image (key, image);
+
+  dir = dup_dir (serial_number);
+  basename = g_strconcat (key, SUFFIX, NULL);
+  data = g_slice_new (SaveData);
+  data->file = g_file_get_child (dir, basename);
+  data->image = image;
+
+  task = g_task_new (NULL, NULL, save_cb, NULL);
+  g_task_set_source_tag (task, og_chart_snapshots_store);
+  g_task_set_task_data (task, data, (GDestroyNotify) save_data_free);
+  g_task_run_in_thread (task, save_thread_func);
+
+  g_object_unref (task);
+  g_object_unref (dir);
+  g_free (basename);
+
+  og_trace_end ("snapshot-store");
+}
+
+void
+og_chart_snapshots_shutdown (void)
+{
+  g_clear_pointer (&snapshots.images, g_hash_table_unref);
+  g_queue_foreach (&snapshots.keys, (GFunc) g_free, NULL);
+  g_queue_clear (&snapshots.keys);
+  g_clear_pointer (&snapshots.loaded_dirs, g_hash_table_unref);
+}
@@ -0,0 +1,27 @@
+#ifndef __OG_CHART_SNAPSHOTS_H__
+#define __OG_CHART_SNAPSHOTS_H__
+
+#include <cairo.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Rendered charts kept as PNG images, the most recent ones in memory and on
+ * disk in the user cache directory, a few per device, so a chart can be shown
+ * right away while its view plots it again. Disk is only accessed from worker
+ * threads. Keys must be usable as file names. */
+void og_chart_snapshots_load_async (const gchar *serial_number,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+gboolean og_chart_snapshots_load_finish (GAsyncResult *result,
+    GError **error);
+cairo_surface_t *og_chart_snapshots_lookup (const gchar *key);
+void og_chart_snapshots_store (const gchar *serial_number,
+    const gchar *key,
+    cairo_surface_t *surface);
+void og_chart_snapshots_shutdown (void);
+
+G_END_DECLS
+
+#endif /* __OG_CHART_SNAPSHOTS_H__ */
@@ -0,0 +1,525 @@
+#include "config.h"
+
+#include "chart-view-pool.h"
+
+#include <string.h>
+
+#include "trace.h"
+
+/* Prewarmed views kept per kind */
+#define POOL_SIZE 1
+
+/* Pages and their data are served by the application itself, all from the
+ * same origin so pages can fetch their data */
+#define SCHEME "og-chart"
+#define BASE_URI SCHEME "://chart/"
+#define DATA_PATH "/data/"
+#define DONE_PATH "/done/"
+
+/* Self-contained pages, see bundle-chart.sh */
+static const gchar *chart_pages[OG_N_CHART_KINDS] = {
+  "modal-day-chart.html", /* OG_CHART_KIND_MODAL_DAY */
+  "average-chart.html",   /* OG_CHART_KIND_AVERAGE */
+};
+
+typedef struct
+{
+  OgChartKind kind;
+  gboolean ready;
+  /* GTasks waiting for the view to be ready, NULL once it is */
+  GList *ready_tasks;
+
+  /* GPtrArray<GBytes> of the latest data published for the page, until it is
+   * done with it */
+  GPtrArray *data;
+  guint data_serial;
+  /* Serial of the latest data the page reported done with, and GTasks
+   * waiting for it to reach theirs */
+  guint done_serial;
+  GList *done_tasks;
+} ViewState;
+
+static struct
+{
+  WebKitWebContext *context;
+  /* Owned WebKitWebView, oldest first */
+  GQueue views[OG_N_CHART_KINDS];
+  guint refill_id;
+
+  /* Number of views loading their page, and GPtrArray<WebKitWebView> of
+   * loaded ones waiting for the others before being ready */
+  guint n_loading;
+  GPtrArray *loaded;
+} pool;
+
+static GQuark
+view_state_quark (void)
+{
+  return g_quark_from_static_string ("og-chart-view-state");
+}
+
+static ViewState *
+get_view_state (WebKitWebView *view)
+{
+  return g_object_get_qdata (G_OBJECT (view), view_state_quark ());
+}
+
+static void
+view_state_free (ViewState *state)
+{
+  g_assert (state->ready_tasks == NULL);
+  g_assert (state->done_tasks == NULL);
+  if (state->data != NULL)
+    g_ptr_array_unref (state->data);
+  g_slice_free (ViewState, state);
+}
+
+static void
+return_task (GTask *task,
+    const GError *error)
+{
+  /* The caller may be gone if cancelled */
+  if (!g_task_return_error_if_cancelled (task))
+    {
+      if (error != NULL)
+        g_task_return_error (task, g_error_copy (error));
+      else
+        g_task_return_boolean (task, TRUE);
+    }
+  g_object_unref (task);
+}
+
+static void
+return_tasks (GList **tasks,
+    const GError *error)
+{
+  GList *list = *tasks;
+  GList *l;
+
+  *tasks = NULL;
+  for (l = list; l != NULL; l = l->next)
+    return_task (l->data, error);
+  g_list_free (list);
+}
+
+/* @path is "<serial>/<chunk>" */
+static GBytes *
+dup_data_chunk (ViewState *state,
+    const gchar *path)
+{
+  guint64 serial;
+  guint64 chunk;
+  gchar *end;
+
+  serial = g_ascii_strtoull (path, &end, 10);
+  if (*end != '/')
+    return NULL;
+  chunk = g_ascii_strtoull (end + 1, NULL, 10);
+
+  /* Superseded data is never served */
+  if (state->data == NULL || serial != state->data_serial ||
+      chunk >= state->data->len)
+    return NULL;
+
+  return g_bytes_ref (g_ptr_array_index (state->data, chunk));
+}
+
+static void
+page_done (ViewState *state,
+    guint serial)
+{
+  GList *done = NULL;
+  GList *l = state->done_tasks;
+
+  state->done_serial = MAX (state->done_serial, serial);
+  if (state->done_serial >= state->data_serial)
+    g_clear_pointer (&state->data, g_ptr_array_unref);
+
+  /* Callbacks may wait again, so returned tasks are unlinked first */
+  while (l != NULL)
+    {
+      GList *next = l->next;
+      GTask *task = l->data;
+
+      if (GPOINTER_TO_UINT (g_task_get_task_data (task)) <= state->done_serial)
+        {
+          state->done_tasks = g_list_remove_link (state->done_tasks, l);
+          done = g_list_concat (done, l);
+        }
+      l = next;
+    }
+
+  return_tasks (&done, NULL);
+}
+
+static void
+uri_scheme_request_cb (WebKitURISchemeRequest *request,
+    gpointer user_data)
+{
+  WebKitWebView *view;
+  ViewState *state = NULL;
+  const gchar *path;
+  const gchar *mime_type = NULL;
+  GBytes *bytes = NULL;
+  GInputStream *stream;
+
+  og_trace_mark ("Serving %s", webkit_uri_scheme_request_get_uri (request));
+
+  view = webkit_uri_scheme_request_get_web_view (request);
+  if (view != NULL)
+    state = get_view_state (view);
+
+  /* Only our views are served */
+  path = webkit_uri_scheme_request_get_path (request);
+  if (state != NULL && g_str_has_prefix (path, DATA_PATH))
+    {
+      bytes = dup_data_chunk (state, path + strlen (DATA_PATH));
+      mime_type = "application/octet-stream";
+    }
+  else if (state != NULL && g_str_has_prefix (path, DONE_PATH))
+    {
+      page_done (state, g_ascii_strtoull (path + strlen (DONE_PATH), NULL, 10));
+      bytes = g_bytes_new_static ("", 0);
+      mime_type = "text/plain";
+    }
+  else if (state != NULL &&
+      g_strcmp0 (path + 1, chart_pages[state->kind]) == 0)
+    {
+      gchar *resource;
+
+      /* Compressed in the resource, so this inflates a copy only needed until
+       * WebKit has it */
+      resource = g_strconcat ("/org/freedesktop/OpenGlucose/src", path, NULL);
+      bytes = g_resources_lookup_data (resource, G_RESOURCE_LOOKUP_FLAGS_NONE,
+          NULL);
+      mime_type = "text/html";
+      g_free (resource);
+    }
+
+  if (bytes == NULL)
+    {
+      GError *error;
+
+      error = g_error_new (G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "%s not found",
+          webkit_uri_scheme_request_get_uri (request));
+      webkit_uri_scheme_request_finish_error (request, error);
+      g_error_free (error);
+      return;
+    }
+
+  stream = g_memory_input_stream_new_from_bytes (bytes);
+  webkit_uri_scheme_request_finish (request, stream, g_bytes_get_size (bytes),
+      mime_type);
+  g_object_unref (stream);
+  g_bytes_unref (bytes);
+}
+
+/* Loaded views are ready once no other view is loading */
+static void
+release_loaded_views (void)
+{
+  guint i;
+
+  for (i = 0; i < pool.loaded->len; i++)
+    {
+      ViewState *state = get_view_state (g_ptr_array_index (pool.loaded, i));
+
+      state->ready = TRUE;
+      return_tasks (&state->ready_tasks, NULL);
+    }
+  g_ptr_array_set_size (pool.loaded, 0);
+}
+
+static void
+view_is_loading_notify_cb (WebKitWebView *view,
+    GParamSpec *param_spec,
+    gpointer user_data)
+{
+  if (webkit_web_view_is_loading (view))
+    return;
+
+  g_signal_handlers_disconnect_by_func (view, view_is_loading_notify_cb,
+      user_data);
+  og_trace_async_end (view, "webkit-load");
+  og_trace_mark ("WebKitWebView loaded for %s",
+      chart_pages[get_view_state (view)->kind]);
+
+  /* For some reason we have to wait for all views within the same process to be
+   * loaded before running scripts, otherwise there are race conditions. Could
+   * be a webkit bug? */
+  g_ptr_array_add (pool.loaded, g_object_ref (view));
+  pool.n_loading--;
+  if (pool.n_loading == 0)
+    release_loaded_views ();
+}
+
+static void
+view_destroy_cb (WebKitWebView *view,
+    gpointer user_data)
+{
+  ViewState *state = get_view_state (view);
+  GError *error;
+
+  /* Its page will never be ready nor report anything */
+  error = g_error_new (G_IO_ERROR, G_IO_ERROR_CLOSED, "Chart view destroyed");
+  return_tasks (&state->ready_tasks, error);
+  return_tasks (&state->done_tasks, error);
+  g_error_free (error);
+
+  /* Otherwise the other views would wait for it forever */
+  if (g_signal_handlers_disconnect_by_func (view, view_is_loading_notify_cb,
+          user_data) > 0)
+    {
+      og_trace_async_end (view, "webkit-load");
+      pool.n_loading--;
+      if (pool.n_loading == 0)
+        release_loaded_views ();
+    }
+}
+
+static WebKitWebView *
+chart_view_new (OgChartKind kind)
+{
+  WebKitWebView *view;
+  ViewState *state;
+  gchar *uri;
+
+  og_trace_begin ("chart-view-new");
+
+  view = (WebKitWebView *) webkit_web_view_new_with_context (pool.context);
+  g_object_ref_sink (view);
+
+  state = g_slice_new0 (ViewState);
+  state->kind = kind;
+  g_object_set_qdata_full (G_OBJECT (view), view_state_quark (), state,
+      (GDestroyNotify) view_state_free);
+
+  g_object_set (webkit_web_view_get_settings (view),
+      "enable-developer-extras", TRUE, NULL);
+
+  uri = g_strconcat (BASE_URI, chart_pages[kind], NULL);
+  og_trace_async_begin (view, "webkit-load", "%s", chart_pages[kind]);
+  webkit_web_view_load_uri (view, uri);
+
+  pool.n_loading++;
+  g_signal_connect (view, "notify::is-loading",
+      G_CALLBACK (view_is_loading_notify_cb), NULL);
+  g_signal_connect (view, "destroy", G_CALLBACK (view_destroy_cb), NULL);
+
+  g_free (uri);
+
+  og_trace_end ("chart-view-new");
+
+  return view;
+}
+
+static gboolean
+refill_cb (gpointer user_data)
+{
+  OgChartKind kind;
+
+  pool.refill_id = 0;
+
+  for (kind = 0; kind < OG_N_CHART_KINDS; kind++)
+    {
+      while (pool.views[kind].length < POOL_SIZE)
+        g_queue_push_tail (&pool.views[kind], chart_view_new (kind));
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Low priority so it does not compete with plotting the views just taken */
+static void
+schedule_refill (void)
+{
+  if (pool.refill_id == 0)
+    pool.refill_id = g_idle_add_full (G_PRIORITY_LOW, refill_cb, NULL, NULL);
+}
+
+void
+og_chart_view_pool_init (void)
+{
+  WebKitSecurityManager *security;
+
+  g_return_if_fail (pool.context == NULL);
+
+  og_trace_begin ("chart-view-pool-init");
+
+  /* Must be set before the web process is spawned. Charts are all local
+   * content of the same origin, sharing one process saves its startup and
+   * memory for each view. */
+  pool.context = g_object_ref (webkit_web_context_get_default ());
+  webkit_web_context_set_process_model (pool.context,
+      WEBKIT_PROCESS_MODEL_SHARED_SECONDARY_PROCESS);
+  webkit_web_context_set_cache_model (pool.context,
+      WEBKIT_CACHE_MODEL_DOCUMENT_VIEWER);
+
+  security = webkit_web_context_get_security_manager (pool.context);
+  webkit_security_manager_register_uri_scheme_as_local (security, SCHEME);
+  webkit_security_manager_register_uri_scheme_as_cors_enabled (security,
+      SCHEME);
+  webkit_web_context_register_uri_scheme (pool.context, SCHEME,
+      uri_scheme_request_cb, NULL, NULL);
+
+  pool.loaded = g_ptr_array_new_with_free_func (g_object_unref);
+
+  /* Prewarm right away, before any device is plugged */
+  refill_cb (NULL);
+
+  og_trace_end ("chart-view-pool-init");
+}
+
+void
+og_chart_view_pool_shutdown (void)
+{
+  OgChartKind kind;
+
+  if (pool.context == NULL)
+    return;
+
+  if (pool.refill_id != 0)
+    g_source_remove (pool.refill_id);
+  pool.refill_id = 0;
+
+  for (kind = 0; kind < OG_N_CHART_KINDS; kind++)
+    {
+      WebKitWebView *view;
+
+      while ((view = g_queue_pop_head (&pool.views[kind])) != NULL)
+        {
+          gtk_widget_destroy ((GtkWidget *) view);
+          g_object_unref (view);
+        }
+    }
+
+  g_clear_pointer (&pool.loaded, g_ptr_array_unref);
+  g_clear_object (&pool.context);
+}
+
+/* Returns a view with the page of @kind loaded or being loaded, see
+ * og_chart_view_pool_wait_ready_async(). Like widget constructors, the
+ * reference is floating. The pool is refilled when idle. */
+WebKitWebView *
+og_chart_view_pool_take (OgChartKind kind)
+{
+  WebKitWebView *view;
+
+  g_return_val_if_fail (pool.context != NULL, NULL);
+  g_return_val_if_fail (kind < OG_N_CHART_KINDS, NULL);
+
+  view = g_queue_pop_head (&pool.views[kind]);
+  if (view == NULL)
+    view = chart_view_new (kind);
+  else
+    og_trace_mark ("Prewarmed %s view taken from the pool",
+        chart_pages[kind]);
+
+  schedule_refill ();
+  g_object_force_floating (G_OBJECT (view));
+
+  return view;
+}
+
+void
+og_chart_view_pool_wait_ready_async (WebKitWebView *view,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  ViewState *state;
+  GTask *task;
+
+  g_return_if_fail (WEBKIT_IS_WEB_VIEW (view));
+
+  state = get_view_state (view);
+  g_return_if_fail (state != NULL);
+
+  task = g_task_new (view, cancellable, callback, user_data);
+  g_task_set_source_tag (task, og_chart_view_pool_wait_ready_async);
+
+  if (state->ready)
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  state->ready_tasks = g_list_append (state->ready_tasks, task);
+}
+
+gboolean
+og_chart_view_pool_wait_ready_finish (WebKitWebView *view,
+    GAsyncResult *result,
+    GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, view), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Serves @chunks, a GPtrArray<GBytes>, to the page of @view. Chunk i is at
+ * "<uri>/<i>", where <uri> is the returned one. The page fetches <uri> with
+ * "done" instead of "data" once it is done with them, see
+ * og_chart_view_pool_wait_done_async(). Chunks are dropped then, or when
+ * publishing again on the same view. */
+gchar *
+og_chart_view_pool_publish (WebKitWebView *view,
+    GPtrArray *chunks)
+{
+  ViewState *state;
+
+  g_return_val_if_fail (WEBKIT_IS_WEB_VIEW (view), NULL);
+  g_return_val_if_fail (chunks != NULL, NULL);
+
+  state = get_view_state (view);
+  g_return_val_if_fail (state != NULL, NULL);
+
+  if (state->data != NULL)
+    g_ptr_array_unref (state->data);
+  state->data = g_ptr_array_ref (chunks);
+  state->data_serial++;
+
+  return g_strdup_printf (BASE_URI "%s%u", DATA_PATH + 1, state->data_serial);
+}
+
+/* Completes once the page reported it is done with the latest data published
+ * on @view, or with any newer one. Pages report it even if they failed to
+ * fetch the data, so this always completes until the view is destroyed. */
+void
+og_chart_view_pool_wait_done_async (WebKitWebView *view,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  ViewState *state;
+  GTask *task;
+
+  g_return_if_fail (WEBKIT_IS_WEB_VIEW (view));
+
+  state = get_view_state (view);
+  g_return_if_fail (state != NULL);
+
+  task = g_task_new (view, cancellable, callback, user_data);
+  g_task_set_source_tag (task, og_chart_view_pool_wait_done_async);
+  g_task_set_task_data (task, GUINT_TO_POINTER (state->data_serial), NULL);
+
+  if (state->done_serial >= state->data_serial)
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  state->done_tasks = g_list_append (state->done_tasks, task);
+}
+
+gboolean
+og_chart_view_pool_wait_done_finish (WebKitWebView *view,
+    GAsyncResult *result,
+    GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, view), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
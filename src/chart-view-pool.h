@@ -0,0 +1,43 @@
+#ifndef __OG_CHART_VIEW_POOL_H__
+#define __OG_CHART_VIEW_POOL_H__
+
+#include <webkit2/webkit2.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  OG_CHART_KIND_MODAL_DAY,
+  OG_CHART_KIND_AVERAGE,
+} OgChartKind;
+#define OG_N_CHART_KINDS (OG_CHART_KIND_AVERAGE + 1)
+
+/* Chart views share a single web context and web process. A few of them are
+ * kept prewarmed, with the page of their kind already loaded, so a newly
+ * plugged device gets views ready to plot. */
+void og_chart_view_pool_init (void);
+void og_chart_view_pool_shutdown (void);
+
+WebKitWebView *og_chart_view_pool_take (OgChartKind kind);
+
+void og_chart_view_pool_wait_ready_async (WebKitWebView *view,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+gboolean og_chart_view_pool_wait_ready_finish (WebKitWebView *view,
+    GAsyncResult *result,
+    GError **error);
+
+gchar *og_chart_view_pool_publish (WebKitWebView *view,
+    GPtrArray *chunks);
+void og_chart_view_pool_wait_done_async (WebKitWebView *view,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+gboolean og_chart_view_pool_wait_done_finish (WebKitWebView *view,
+    GAsyncResult *result,
+    GError **error);
+
+G_END_DECLS
+
+#endif /* __OG_CHART_VIEW_POOL_H__ */
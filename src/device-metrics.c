@@ -0,0 +1,173 @@
+#include "config.h"
+
+#include "device-metrics.h"
+
+static OgLatencyHistogram *
+latency_histogram_new (const gchar *command)
+{
+  OgLatencyHistogram *histogram;
+
+  histogram = g_slice_new0 (OgLatencyHistogram);
+  histogram->command = g_strdup (command);
+
+  return histogram;
+}
+
+static OgLatencyHistogram *
+latency_histogram_copy (const OgLatencyHistogram *histogram)
+{
+  OgLatencyHistogram *copy;
+
+  copy = g_slice_dup (OgLatencyHistogram, histogram);
+  copy->command = g_strdup (histogram->command);
+
+  return copy;
+}
+
+static void
+latency_histogram_free (OgLatencyHistogram *histogram)
+{
+  g_free (histogram->command);
+  g_slice_free (OgLatencyHistogram, histogram);
+}
+
+OgDeviceMetrics *
+og_device_metrics_new (void)
+{
+  OgDeviceMetrics *self;
+
+  self = g_slice_new0 (OgDeviceMetrics);
+  self->latencies = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) latency_histogram_free);
+
+  return self;
+}
+
+OgDeviceMetrics *
+og_device_metrics_copy (const OgDeviceMetrics *self)
+{
+  OgDeviceMetrics *copy;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  copy = g_slice_dup (OgDeviceMetrics, self);
+  copy->latencies = g_ptr_array_new_full (self->latencies->len,
+      (GDestroyNotify) latency_histogram_free);
+  for (i = 0; i < self->latencies->len; i++)
+    g_ptr_array_add (copy->latencies,
+        latency_histogram_copy (g_ptr_array_index (self->latencies, i)));
+
+  return copy;
+}
+
+void
+og_device_metrics_free (OgDeviceMetrics *self)
+{
+  if (self == NULL)
+    return;
+
+  g_ptr_array_unref (self->latencies);
+  g_slice_free (OgDeviceMetrics, self);
+}
+
+const OgLatencyHistogram *
+og_device_metrics_get_latency (const OgDeviceMetrics *self,
+    const gchar *command)
+{
+  guint i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (command != NULL, NULL);
+
+  for (i = 0; i < self->latencies->len; i++)
+    {
+      OgLatencyHistogram *histogram = g_ptr_array_index (self->latencies, i);
+
+      if (g_str_equal (histogram->command, command))
+        return histogram;
+    }
+
+  return NULL;
+}
+
+void
+og_device_metrics_add_latency (OgDeviceMetrics *self,
+    const gchar *command,
+    GTimeSpan latency)
+{
+  OgLatencyHistogram *histogram;
+  GTimeSpan ms;
+  guint bucket;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (command != NULL);
+
+  histogram = (OgLatencyHistogram *) og_device_metrics_get_latency (self,
+      command);
+  if (histogram == NULL)
+    {
+      histogram = latency_histogram_new (command);
+      g_ptr_array_add (self->latencies, histogram);
+    }
+
+  if (histogram->n_samples == 0 || latency < histogram->min)
+    histogram->min = latency;
+  if (histogram->n_samples == 0 || latency > histogram->max)
+    histogram->max = latency;
+  histogram->n_samples++;
+  histogram->total += latency;
+
+  ms = latency / G_TIME_SPAN_MILLISECOND;
+  for (bucket = 0; ms > 0 && bucket < OG_LATENCY_HISTOGRAM_N_BUCKETS - 1;
+      bucket++)
+    ms >>= 1;
+  histogram->buckets[bucket]++;
+}
+
+void
+og_device_metrics_add_frame (OgDeviceMetrics *self,
+    gsize n_bytes)
+{
+  g_return_if_fail (self != NULL);
+
+  self->n_frames++;
+  self->n_bytes += n_bytes;
+  self->window_frames++;
+  self->window_bytes += n_bytes;
+}
+
+void
+og_device_metrics_add_record (OgDeviceMetrics *self)
+{
+  g_return_if_fail (self != NULL);
+
+  self->n_records++;
+  self->window_records++;
+}
+
+/* Close the current measurement window, which lasted @elapsed, and compute
+ * the rates from it. Returns FALSE if nothing happened during the window. */
+gboolean
+og_device_metrics_update_rates (OgDeviceMetrics *self,
+    GTimeSpan elapsed)
+{
+  gdouble seconds;
+  gboolean active;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (elapsed > 0, FALSE);
+
+  seconds = (gdouble) elapsed / G_TIME_SPAN_SECOND;
+  active = (self->window_frames > 0 || self->window_records > 0);
+
+  self->frames_per_second = self->window_frames / seconds;
+  self->bytes_per_second = self->window_bytes / seconds;
+  self->records_per_second = self->window_records / seconds;
+
+  self->window_frames = 0;
+  self->window_bytes = 0;
+  self->window_records = 0;
+
+  return active;
+}
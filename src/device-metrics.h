@@ -0,0 +1,64 @@
+#ifndef __OG_DEVICE_METRICS_H__
+#define __OG_DEVICE_METRICS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Bucket 0 counts latencies below 1ms, bucket i counts latencies in
+ * [2^(i-1), 2^i) ms and the last bucket everything above. */
+#define OG_LATENCY_HISTOGRAM_N_BUCKETS 16
+
+typedef struct
+{
+  gchar *command;
+  guint n_samples;
+  gint64 total;
+  gint64 min;
+  gint64 max;
+  guint buckets[OG_LATENCY_HISTOGRAM_N_BUCKETS];
+} OgLatencyHistogram;
+
+typedef struct
+{
+  /* GPtrArray<owned OgLatencyHistogram> */
+  GPtrArray *latencies;
+
+  guint64 n_frames;
+  guint64 n_bytes;
+  guint64 n_records;
+  guint n_checksum_failures;
+  guint n_retries;
+
+  /* Rates measured over the last elapsed window */
+  gdouble frames_per_second;
+  gdouble bytes_per_second;
+  gdouble records_per_second;
+
+  /* < private > */
+  guint64 window_frames;
+  guint64 window_bytes;
+  guint64 window_records;
+} OgDeviceMetrics;
+
+OgDeviceMetrics *og_device_metrics_new (void);
+OgDeviceMetrics *og_device_metrics_copy (const OgDeviceMetrics *self);
+void og_device_metrics_free (OgDeviceMetrics *self);
+
+void og_device_metrics_add_latency (OgDeviceMetrics *self,
+    const gchar *command,
+    GTimeSpan latency);
+void og_device_metrics_add_frame (OgDeviceMetrics *self,
+    gsize n_bytes);
+void og_device_metrics_add_record (OgDeviceMetrics *self);
+
+gboolean og_device_metrics_update_rates (OgDeviceMetrics *self,
+    GTimeSpan elapsed);
+
+const OgLatencyHistogram *og_device_metrics_get_latency (
+    const OgDeviceMetrics *self,
+    const gchar *command);
+
+G_END_DECLS
+
+#endif /* __OG_DEVICE_METRICS_H__ */
@@ -2,18 +2,49 @@
 
 #include "device-widget.h"
 
-#include <webkit2/webkit2.h>
+#include <string.h>
 #include <glib/gi18n.h>
+#ifdef ENABLE_WEBKIT
+#include <webkit2/webkit2.h>
+#endif
+
+#include "average-chart.h"
+#include "calendar-chart.h"
+#include "chart-data.h"
+#ifdef ENABLE_WEBKIT
+#include "chart-snapshots.h"
+#include "chart-view-pool.h"
+#endif
+#include "modal-day-chart.h"
+#include "timeline-chart.h"
+#include "trace.h"
 
 #define DEBUG g_debug
 
-/* FIXME: This should be user-defined, or even stored on device */
-/* FIXME: It is in mg/dl unit */
-#define HYPOGLYCEMIA 60
-#define HYPERGLYCEMIA 170
+/* Only the most recent episodes are listed */
+#define MAX_LISTED_EPISODES 100
 
 G_DEFINE_TYPE (OgDeviceWidget, og_device_widget, GTK_TYPE_BIN)
 
+#ifdef ENABLE_WEBKIT
+/* Plot updates of a chart view. At most one is in flight, until the view is
+ * done with it, and only the latest of those requested meanwhile is kept.
+ *
+ * Each update has the key of its chart snapshot. The snapshot of the latest
+ * request, if any, is shown over the view until it is done, then the view is
+ * snapshotted in turn. */
+typedef struct
+{
+  gboolean in_flight;
+  gchar *in_flight_key;
+  gchar *pending;
+  gchar *pending_key;
+  /* Of the latest update requested, NULL if unknown */
+  gchar *requested_key;
+  GtkWidget *snapshot;
+} ChartUpdates;
+#endif
+
 struct _OgDeviceWidgetPrivate
 {
   OgBaseDevice *device;
@@ -21,13 +52,50 @@ struct _OgDeviceWidgetPrivate
   GtkWidget *main_vbox;
   GtkWidget *info_bar;
   GtkWidget *info_bar_label;
+  GtkWidget *progress_bar;
   GtkWidget *spinner;
 
+  GtkWidget *mean_label;
+  GtkWidget *sd_label;
+  GtkWidget *a1c_label;
+  GtkWidget *time_in_range_label;
+  GtkWidget *hypoglycemia_spin_button;
+  GtkWidget *hyperglycemia_spin_button;
+  GtkWidget *variability_label;
+  GtkWidget *meals_label;
+  GtkWidget *episodes_expander;
+  GtkWidget *episodes_list;
+
+#ifdef ENABLE_WEBKIT
   WebKitWebView *modal_day_view;
   WebKitWebView *average_view;
-  guint n_loading_views;
-
-  gint64 time_span;
+  GCancellable *views_cancellable;
+  /* OgChartDataFlags of views whose page is loaded */
+  guint charts_loaded;
+  ChartUpdates modal_day_updates;
+  ChartUpdates average_updates;
+  /* Chart data being built in a worker, if any */
+  GCancellable *chart_data_cancellable;
+  guint chart_data_flags;
+  gsize modal_day_script_size;
+  gsize average_script_size;
+#else
+  OgModalDayChart *modal_day_chart;
+  OgAverageChart *average_chart;
+#endif
+  /* Native with either backend */
+  OgTimelineChart *timeline_chart;
+  OgCalendarChart *calendar_chart;
+
+  OgTimeSpan time_span;
+  /* Bucket width of the modal day mean, in minutes, 0 for smoothed */
+  guint modal_day_width;
+  /* OgMealTag of readings in the modal day, or OG_MEAL_TAG_ANY */
+  guint meal_tag;
+  guint hypoglycemia;
+  guint hyperglycemia;
+  /* Gap tolerance of episodes, in seconds */
+  gint64 episode_max_gap;
 };
 
 enum
@@ -36,17 +104,7 @@ enum
   PROP_DEVICE,
 };
 
-static gchar *
-dup_basedir (void)
-{
-  const gchar *basedir;
-
-  basedir = g_getenv ("OPENGLUCOSE_SRCDIR");
-  if (basedir == NULL)
-    basedir = DATA_DIR;
-
-  return g_strdup_printf ("file://%s/", basedir);
-}
+#ifdef ENABLE_WEBKIT
 
 static void
 run_javascript_cb (GObject *source,
@@ -57,37 +115,59 @@ run_javascript_cb (GObject *source,
   WebKitJavascriptResult *js_result;
   GError *error = NULL;
 
+  og_trace_async_end (view, "run-javascript");
+
   js_result = webkit_web_view_run_javascript_finish (view, result, &error);
   if (js_result == NULL)
     {
       g_warning ("Error running javascript: %s", error->message);
       g_clear_error (&error);
+      g_object_unref (user_data);
       return;
     }
 
   webkit_javascript_result_unref (js_result);
+  g_object_unref (user_data);
+}
+
+static const gchar *
+view_name (OgDeviceWidget *self,
+    WebKitWebView *view)
+{
+  return view == self->priv->modal_day_view ? "modal day" : "average";
 }
 
 static void
 run_javascript_literal (OgDeviceWidget *self,
     WebKitWebView *view,
+    GAsyncReadyCallback callback,
     const gchar *script)
 {
   g_assert (!webkit_web_view_is_loading (view));
   DEBUG ("Run script on view %p:\n%s", view, script);
 
+  if (view == self->priv->modal_day_view)
+    self->priv->modal_day_script_size = strlen (script) + 1;
+  else
+    self->priv->average_script_size = strlen (script) + 1;
+
+  og_trace_async_begin (view, "run-javascript", "%.32s", script);
+
+  /* Callbacks must chain up to run_javascript_cb() */
   webkit_web_view_run_javascript (view, script, NULL,
-      run_javascript_cb, self);
+      callback, g_object_ref (self));
 }
 
 static void run_javascript (OgDeviceWidget *self,
     WebKitWebView *view,
+    GAsyncReadyCallback callback,
     const gchar *format,
-    ...) G_GNUC_PRINTF (3, 4);
+    ...) G_GNUC_PRINTF (4, 5);
 
 static void
 run_javascript (OgDeviceWidget *self,
     WebKitWebView *view,
+    GAsyncReadyCallback callback,
     const gchar *format,
     ...)
 {
@@ -98,220 +178,759 @@ run_javascript (OgDeviceWidget *self,
   script = g_strdup_vprintf (format, args);
   va_end (args);
 
-  run_javascript_literal (self, view, script);
+  run_javascript_literal (self, view, callback, script);
 
   g_free (script);
 }
 
-static gboolean
-in_range (OgDeviceWidget *self,
-    GDateTime *now,
-    GDateTime *dt)
+static ChartUpdates *
+get_chart_updates (OgDeviceWidget *self,
+    WebKitWebView *view)
+{
+  return view == self->priv->modal_day_view ?
+      &self->priv->modal_day_updates : &self->priv->average_updates;
+}
+
+static void
+clear_chart_updates (ChartUpdates *updates)
+{
+  g_clear_pointer (&updates->in_flight_key, g_free);
+  g_clear_pointer (&updates->pending, g_free);
+  g_clear_pointer (&updates->pending_key, g_free);
+  g_clear_pointer (&updates->requested_key, g_free);
+  /* Destroyed with the overlay */
+  updates->snapshot = NULL;
+}
+
+static void run_chart_update (OgDeviceWidget *self,
+    WebKitWebView *view,
+    gchar *script,
+    gchar *key);
+
+/* The view may outlive the widget, the snapshot is stored under the serial
+ * number it was taken for */
+typedef struct
 {
-  if (self->priv->time_span < 0)
-    return TRUE;
+  gchar *serial_number;
+  gchar *key;
+} SnapshotRequest;
 
-  return (g_date_time_difference (now, dt) <= self->priv->time_span);
+static void
+snapshot_request_free (SnapshotRequest *request)
+{
+  g_free (request->serial_number);
+  g_free (request->key);
+  g_slice_free (SnapshotRequest, request);
 }
 
-static gchar *
-dup_modal_day_data (OgDeviceWidget *self)
+static void
+snapshot_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
 {
-  GDateTime *now;
-  GString *string;
-  const OgRecord * const *records;
-  struct { guint sum; guint n_values; } averages[12] = {};
-  guint i;
+  WebKitWebView *view = (WebKitWebView *) source;
+  SnapshotRequest *request = user_data;
+  cairo_surface_t *surface;
+  GError *error = NULL;
 
-  now = g_date_time_new_now_local ();
-  records = og_base_device_get_records (self->priv->device);
+  og_trace_async_end (view, "snapshot");
 
-  string = g_string_new ("[[");
-  for (i = 0; records[i] != NULL; i++)
+  surface = webkit_web_view_get_snapshot_finish (view, result, &error);
+  if (surface == NULL)
     {
-      guint p;
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Error taking chart snapshot: %s", error->message);
+      g_clear_error (&error);
+      snapshot_request_free (request);
+      return;
+    }
 
-      if (!in_range (self, now, records[i]->datetime))
-        continue;
+  og_chart_snapshots_store (request->serial_number, request->key, surface);
+
+  cairo_surface_destroy (surface);
+  snapshot_request_free (request);
+}
+
+static void
+chart_update_done (OgDeviceWidget *self,
+    WebKitWebView *view)
+{
+  ChartUpdates *updates;
+  gchar *script;
+  gchar *key;
 
-      p = g_date_time_get_hour (records[i]->datetime) / 2;
-      averages[p].sum += records[i]->glycemia;
-      averages[p].n_values++;
+  /* Scripts still complete once the widget is disposed, with its charts
+   * destroyed */
+  if (self->priv->views_cancellable == NULL)
+    return;
+
+  updates = get_chart_updates (self, view);
+  og_trace_async_end (updates, "chart-update");
+  updates->in_flight = FALSE;
 
-      g_string_append_printf (string, "[new Date(0,0,0,%u,%u,0,0),%u],",
-          g_date_time_get_hour (records[i]->datetime),
-          g_date_time_get_minute (records[i]->datetime),
-          records[i]->glycemia);
+  script = updates->pending;
+  key = updates->pending_key;
+  updates->pending = NULL;
+  updates->pending_key = NULL;
+  if (script != NULL)
+    {
+      g_free (updates->in_flight_key);
+      updates->in_flight_key = NULL;
+      run_chart_update (self, view, script, key);
+      return;
     }
-  g_string_append (string, "],[");
-  for (i = 0; i < 12; i++)
+
+  /* The view is up to date, it replaces the snapshot and is snapshotted in
+   * turn */
+  gtk_widget_hide (updates->snapshot);
+  if (updates->in_flight_key != NULL)
     {
-      if (averages[i].n_values == 0)
-        continue;
+      SnapshotRequest *request = g_slice_new (SnapshotRequest);
+
+      request->serial_number = g_strdup (
+          og_base_device_get_serial_number (self->priv->device));
+      request->key = updates->in_flight_key;
+      updates->in_flight_key = NULL;
 
-      g_string_append_printf (string, "[new Date(0,0,0,%u,0,0,0),%u],",
-          i * 2 + 1, averages[i].sum / averages[i].n_values);
+      og_trace_async_begin (view, "snapshot", "%s", view_name (self, view));
+      webkit_web_view_get_snapshot (view, WEBKIT_SNAPSHOT_REGION_VISIBLE,
+          WEBKIT_SNAPSHOT_OPTIONS_NONE, self->priv->views_cancellable,
+          snapshot_cb, request);
     }
-  g_string_append (string, "]]");
+}
 
-  g_date_time_unref (now);
+static void
+chart_page_done_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  OgDeviceWidget *self = user_data;
+  WebKitWebView *view = (WebKitWebView *) source;
+  GError *error = NULL;
+
+  /* Otherwise the view or the widget is gone */
+  if (og_chart_view_pool_wait_done_finish (view, result, &error))
+    chart_update_done (self, view);
+  g_clear_error (&error);
 
-  return g_string_free (string, FALSE);
+  g_object_unref (self);
 }
 
 static void
-modal_day_chart_run_js_cb (GObject *source,
+chart_update_run_cb (GObject *source,
     GAsyncResult *result,
     gpointer user_data)
 {
   OgDeviceWidget *self = user_data;
   WebKitWebView *view = (WebKitWebView *) source;
-  WebKitJavascriptResult *js_result;
-  gchar *data;
+
+  /* The modal day page fetches its data itself, and reports when it is done
+   * plotting it */
+  if (view != self->priv->modal_day_view)
+    chart_update_done (self, view);
+
+  run_javascript_cb (source, result, user_data);
+}
+
+/* Takes ownership of @script and @key */
+static void
+run_chart_update (OgDeviceWidget *self,
+    WebKitWebView *view,
+    gchar *script,
+    gchar *key)
+{
+  ChartUpdates *updates = get_chart_updates (self, view);
+
+  updates->in_flight = TRUE;
+  updates->in_flight_key = key;
+  og_trace_async_begin (updates, "chart-update", "%s",
+      view_name (self, view));
+
+  if (view == self->priv->modal_day_view)
+    og_chart_view_pool_wait_done_async (view, self->priv->views_cancellable,
+        chart_page_done_cb, g_object_ref (self));
+  run_javascript_literal (self, view, chart_update_run_cb, script);
+
+  g_free (script);
+}
+
+/* Takes ownership of @script. Scripts must plot or replot the whole chart, so
+ * any of them can supersede the others. The update is snapshotted under the
+ * latest requested key. */
+static void
+schedule_chart_update (OgDeviceWidget *self,
+    WebKitWebView *view,
+    gchar *script)
+{
+  ChartUpdates *updates = get_chart_updates (self, view);
+  gchar *key = g_strdup (updates->requested_key);
+
+  if (!updates->in_flight)
+    {
+      run_chart_update (self, view, script, key);
+      return;
+    }
+
+  if (updates->pending != NULL)
+    og_trace_mark ("Update of %s view superseded", view_name (self, view));
+  g_free (updates->pending);
+  g_free (updates->pending_key);
+  updates->pending = script;
+  updates->pending_key = key;
+}
+
+static void
+chart_data_built_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  OgDeviceWidget *self = user_data;
+  OgChartData *data;
   GError *error = NULL;
 
-  js_result = webkit_web_view_run_javascript_from_gresource_finish (view,
-      result, &error);
-  if (js_result == NULL)
+  data = og_chart_data_build_finish (result, &error);
+  if (data == NULL)
     {
-      g_warning ("Error running javascript: %s", error->message);
+      /* Superseded by a newer request, or the widget is gone */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Error building chart data: %s", error->message);
       g_clear_error (&error);
+      g_object_unref (self);
       return;
     }
 
-  data = dup_modal_day_data (self);
-  run_javascript (self, self->priv->modal_day_view,
-      "OgChartPlot('%s',%u,%u,%s);",
-      _("Modal Day Report"),
-      HYPOGLYCEMIA, HYPERGLYCEMIA, data);
+  og_trace_async_end (self, "chart-data");
+  g_clear_object (&self->priv->chart_data_cancellable);
+  self->priv->chart_data_flags = 0;
 
-  g_free (data);
-  webkit_javascript_result_unref (js_result);
+  /* The page fetches its packed data itself, then plots it or replots it. The
+   * thresholds are only used the first time. Publishing right away drops the
+   * data of any superseded update. */
+  if (og_chart_data_get_flags (data) & OG_CHART_DATA_MODAL_DAY)
+    {
+      gchar *uri;
+
+      uri = og_chart_view_pool_publish (self->priv->modal_day_view,
+          og_chart_data_get_modal_day (data));
+      schedule_chart_update (self, self->priv->modal_day_view,
+          g_strdup_printf ("OgChartLoad('%s','%s',%u,%u);",
+              uri, _("Modal Day Report"),
+              self->priv->hypoglycemia, self->priv->hyperglycemia));
+      g_free (uri);
+    }
+
+  if (og_chart_data_get_flags (data) & OG_CHART_DATA_AVERAGE)
+    schedule_chart_update (self, self->priv->average_view,
+        g_strdup_printf ("OgChartUpdate('%s',%s);",
+            _("Average"), og_chart_data_get_average (data)));
+
+  og_chart_data_free (data);
+  g_object_unref (self);
 }
 
+/* Identifies what the chart of @view shows: the device, the settings of the
+ * chart and the version of the data, from the records received and the day
+ * spans are anchored to */
 static gchar *
-dup_average_data (OgDeviceWidget *self)
+dup_snapshot_key (OgDeviceWidget *self,
+    WebKitWebView *view)
 {
-  GDateTime *now;
   const OgRecord * const *records;
-  guint n_hypo = 0;
-  guint n_good = 0;
-  guint n_hyper = 0;
-  gchar *ret;
-  guint i;
+  OgStats *stats;
+  GDateTime *now;
+  gchar *today;
+  gchar *description;
+  gchar *key;
+  guint n_records;
+  gint64 last_time = 0;
+  gboolean modal_day = view == self->priv->modal_day_view;
+
+  /* Records are only ever appended */
+  records = og_base_device_get_records (self->priv->device);
+  stats = og_base_device_get_stats (self->priv->device);
+  n_records = og_stats_get_n_records (stats);
+  if (n_records > 0)
+    last_time = g_date_time_to_unix (records[n_records - 1]->datetime);
 
   now = g_date_time_new_now_local ();
-  records = og_base_device_get_records (self->priv->device);
-  for (i = 0; records[i] != NULL; i++)
+  today = g_date_time_format (now, "%F");
+  description = g_strdup_printf ("%s|%s|%u|%u|%u|%u|%u|%u|%" G_GINT64_FORMAT
+      "|%s",
+      og_base_device_get_serial_number (self->priv->device),
+      view_name (self, view), self->priv->time_span,
+      modal_day ? self->priv->meal_tag : 0,
+      modal_day ? self->priv->modal_day_width : 0,
+      self->priv->hypoglycemia, self->priv->hyperglycemia,
+      n_records, last_time, today);
+  key = g_compute_checksum_for_string (G_CHECKSUM_SHA1, description, -1);
+
+  g_free (description);
+  g_free (today);
+  g_date_time_unref (now);
+
+  return key;
+}
+
+/* Shows the snapshot stored under @key over @view, or hides it if there is
+ * none */
+static void
+show_snapshot (OgDeviceWidget *self,
+    WebKitWebView *view,
+    const gchar *key)
+{
+  ChartUpdates *updates = get_chart_updates (self, view);
+  cairo_surface_t *surface;
+
+  surface = og_chart_snapshots_lookup (key);
+  if (surface != NULL)
     {
-      if (!in_range (self, now, records[i]->datetime))
-        continue;
+      og_trace_mark ("Snapshot shown for %s", view_name (self, view));
+      gtk_image_set_from_surface ((GtkImage *) updates->snapshot, surface);
+      gtk_widget_show (updates->snapshot);
+      cairo_surface_destroy (surface);
+    }
+  else
+    {
+      gtk_widget_hide (updates->snapshot);
+    }
+}
 
-      if (records[i]->glycemia < HYPOGLYCEMIA)
-        n_hypo++;
-      else if (records[i]->glycemia < HYPERGLYCEMIA)
-        n_good++;
-      else
-        n_hyper++;
+/* Shows the snapshot of the chart about to be requested over @view, if there
+ * is one. Returns FALSE if that chart was requested already, so the view shows
+ * it or soon will. */
+static gboolean
+prepare_chart_update (OgDeviceWidget *self,
+    WebKitWebView *view,
+    OgChartDataFlags flag)
+{
+  ChartUpdates *updates = get_chart_updates (self, view);
+  gchar *key;
+
+  key = dup_snapshot_key (self, view);
+  if (g_strcmp0 (key, updates->requested_key) == 0)
+    {
+      g_free (key);
+      return FALSE;
     }
 
-  ret = g_strdup_printf ("[['%s',%u],['%s',%u],['%s',%u]]",
-      _("Hypoglycemia"), n_hypo,
-      _("Good"), n_good,
-      _("Hyperglycemia"), n_hyper);
+  show_snapshot (self, view, key);
 
-  g_date_time_unref (now);
+  /* Otherwise it is requested once the page is loaded */
+  if (self->priv->charts_loaded & flag)
+    {
+      g_free (updates->requested_key);
+      updates->requested_key = key;
+    }
+  else
+    {
+      g_free (key);
+    }
 
-  return ret;
+  return TRUE;
 }
 
+/* Chart data is built in a worker thread. A newer request cancels the one in
+ * flight and takes over its charts, so only the latest data is delivered to
+ * the views. */
 static void
-average_chart_run_js_cb (GObject *source,
+update_charts (OgDeviceWidget *self,
+    OgChartDataFlags flags)
+{
+  OgChartData *data;
+
+  /* Snapshots are shown right away, even before the page is loaded. Charts
+   * already requested are not plotted again. */
+  if ((flags & OG_CHART_DATA_MODAL_DAY) &&
+      !prepare_chart_update (self, self->priv->modal_day_view,
+          OG_CHART_DATA_MODAL_DAY))
+    flags &= ~OG_CHART_DATA_MODAL_DAY;
+  if ((flags & OG_CHART_DATA_AVERAGE) &&
+      !prepare_chart_update (self, self->priv->average_view,
+          OG_CHART_DATA_AVERAGE))
+    flags &= ~OG_CHART_DATA_AVERAGE;
+
+  /* Other views will ask for data once their chart script is loaded */
+  flags &= self->priv->charts_loaded;
+  if (flags == 0)
+    return;
+
+  if (self->priv->chart_data_cancellable != NULL)
+    {
+      og_trace_async_end (self, "chart-data");
+      g_cancellable_cancel (self->priv->chart_data_cancellable);
+      g_clear_object (&self->priv->chart_data_cancellable);
+      flags |= self->priv->chart_data_flags;
+    }
+
+  data = og_chart_data_new (og_base_device_get_stats (self->priv->device),
+      flags, self->priv->time_span, self->priv->meal_tag,
+      self->priv->modal_day_width,
+      self->priv->hypoglycemia, self->priv->hyperglycemia);
+
+  self->priv->chart_data_flags = flags;
+  self->priv->chart_data_cancellable = g_cancellable_new ();
+  og_trace_async_begin (self, "chart-data", "%s%s",
+      flags & OG_CHART_DATA_MODAL_DAY ? "modal day " : "",
+      flags & OG_CHART_DATA_AVERAGE ? "average" : "");
+  og_chart_data_build_async (data, self->priv->chart_data_cancellable,
+      chart_data_built_cb, g_object_ref (self));
+}
+
+/* Saved snapshots of the charts still to be plotted are shown once loaded */
+static void
+show_loaded_snapshot (OgDeviceWidget *self,
+    WebKitWebView *view,
+    OgChartDataFlags flag)
+{
+  ChartUpdates *updates = get_chart_updates (self, view);
+  gchar *key;
+
+  if (gtk_widget_get_visible (updates->snapshot))
+    return;
+  if ((self->priv->charts_loaded & flag) && !updates->in_flight &&
+      !(self->priv->chart_data_flags & flag))
+    return;
+
+  key = dup_snapshot_key (self, view);
+  show_snapshot (self, view, key);
+  g_free (key);
+}
+
+static void
+snapshots_loaded_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  OgDeviceWidget *self = user_data;
+  GError *error = NULL;
+
+  if (!og_chart_snapshots_load_finish (result, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Error loading chart snapshots: %s", error->message);
+      g_clear_error (&error);
+      g_object_unref (self);
+      return;
+    }
+
+  show_loaded_snapshot (self, self->priv->modal_day_view,
+      OG_CHART_DATA_MODAL_DAY);
+  show_loaded_snapshot (self, self->priv->average_view,
+      OG_CHART_DATA_AVERAGE);
+
+  g_object_unref (self);
+}
+
+static void
+chart_view_ready_cb (GObject *source,
     GAsyncResult *result,
     gpointer user_data)
 {
   OgDeviceWidget *self = user_data;
   WebKitWebView *view = (WebKitWebView *) source;
-  WebKitJavascriptResult *js_result;
-  gchar *data;
+  OgChartDataFlags flag;
   GError *error = NULL;
 
-  js_result = webkit_web_view_run_javascript_from_gresource_finish (view,
-      result, &error);
-  if (js_result == NULL)
+  if (!og_chart_view_pool_wait_ready_finish (view, result, &error))
     {
-      g_warning ("Error running javascript: %s", error->message);
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Error loading chart view: %s", error->message);
       g_clear_error (&error);
+      g_object_unref (self);
       return;
     }
 
-  data = dup_average_data (self);
-  run_javascript (self, self->priv->average_view,
-      "OgChartPlot('%s',%s);",
-      _("Average"), data);
+  og_trace_mark ("Chart view ready for %s", view_name (self, view));
 
-  g_free (data);
-  webkit_javascript_result_unref (js_result);
+  flag = view == self->priv->modal_day_view ?
+      OG_CHART_DATA_MODAL_DAY : OG_CHART_DATA_AVERAGE;
+  self->priv->charts_loaded |= flag;
+  update_charts (self, flag);
+
+  g_object_unref (self);
+}
+
+static WebKitWebView *
+take_chart_view (OgDeviceWidget *self,
+    OgChartKind kind)
+{
+  WebKitWebView *view;
+
+  view = og_chart_view_pool_take (kind);
+  og_chart_view_pool_wait_ready_async (view, self->priv->views_cancellable,
+      chart_view_ready_cb, g_object_ref (self));
+
+  return view;
+}
+
+/* Snapshots are shown over the view */
+static GtkWidget *
+create_chart_overlay (OgDeviceWidget *self,
+    WebKitWebView *view)
+{
+  ChartUpdates *updates = get_chart_updates (self, view);
+  GtkWidget *overlay;
+
+  overlay = gtk_overlay_new ();
+  gtk_container_add (GTK_CONTAINER (overlay), (GtkWidget *) view);
+  gtk_widget_show ((GtkWidget *) view);
+
+  updates->snapshot = gtk_image_new ();
+  gtk_overlay_add_overlay (GTK_OVERLAY (overlay), updates->snapshot);
+
+  return overlay;
+}
+
+static GtkWidget *
+create_modal_day_chart (OgDeviceWidget *self)
+{
+  self->priv->modal_day_view = take_chart_view (self,
+      OG_CHART_KIND_MODAL_DAY);
+
+  return create_chart_overlay (self, self->priv->modal_day_view);
+}
+
+static GtkWidget *
+create_average_chart (OgDeviceWidget *self)
+{
+  self->priv->average_view = take_chart_view (self, OG_CHART_KIND_AVERAGE);
+
+  return create_chart_overlay (self, self->priv->average_view);
 }
 
 static void
-view_is_loading_notify_cb (WebKitWebView *view,
-    GParamSpec *param_spec,
-    OgDeviceWidget *self)
+update_chart_thresholds (OgDeviceWidget *self)
 {
-  if (webkit_web_view_is_loading (view))
-    return;
+  /* Otherwise it gets current thresholds when first plotted. The chart then
+   * matches none of the requested ones. */
+  if (self->priv->charts_loaded & OG_CHART_DATA_MODAL_DAY)
+    {
+      run_javascript (self, self->priv->modal_day_view, run_javascript_cb,
+          "OgChartSetThresholds(%u,%u);",
+          self->priv->hypoglycemia, self->priv->hyperglycemia);
+      g_clear_pointer (&self->priv->modal_day_updates.requested_key, g_free);
+    }
+}
 
-  g_signal_handlers_disconnect_by_func (view, view_is_loading_notify_cb, self);
+#else /* ENABLE_WEBKIT */
 
-  /* For some reason we have to wait for all views within the same process to be
-   * loaded before running scripts, otherwise there are race conditions. Could
-   * be a webkit bug? */
-  self->priv->n_loading_views--;
-  if (self->priv->n_loading_views > 0)
+static GtkWidget *
+create_modal_day_chart (OgDeviceWidget *self)
+{
+  GtkWidget *chart;
+
+  chart = og_modal_day_chart_new ();
+  self->priv->modal_day_chart = (OgModalDayChart *) chart;
+
+  return chart;
+}
+
+static GtkWidget *
+create_average_chart (OgDeviceWidget *self)
+{
+  GtkWidget *chart;
+
+  chart = og_average_chart_new ();
+  self->priv->average_chart = (OgAverageChart *) chart;
+
+  return chart;
+}
+
+/* Native charts draw straight from the copied readings, there is no script to
+ * build so it is all done on the main thread */
+static void
+update_charts (OgDeviceWidget *self,
+    OgChartDataFlags flags)
+{
+  OgStats *stats;
+
+  /* Charts are not created yet */
+  if (self->priv->modal_day_chart == NULL)
     return;
 
-  webkit_web_view_run_javascript_from_gresource (self->priv->modal_day_view,
-      "/org/freedesktop/OpenGlucose/src/modal-day-chart.js",
-      NULL, modal_day_chart_run_js_cb, self);
-  webkit_web_view_run_javascript_from_gresource (self->priv->average_view,
-      "/org/freedesktop/OpenGlucose/src/average-chart.js",
-      NULL, average_chart_run_js_cb, self);
+  stats = og_base_device_get_stats (self->priv->device);
+  if (flags & OG_CHART_DATA_MODAL_DAY)
+    og_modal_day_chart_set_data (self->priv->modal_day_chart,
+        og_chart_data_new (stats, OG_CHART_DATA_MODAL_DAY,
+            self->priv->time_span, self->priv->meal_tag,
+            self->priv->modal_day_width,
+            self->priv->hypoglycemia, self->priv->hyperglycemia));
+  if (flags & OG_CHART_DATA_AVERAGE)
+    og_average_chart_set_data (self->priv->average_chart,
+        og_chart_data_new (stats, OG_CHART_DATA_AVERAGE,
+            self->priv->time_span, self->priv->meal_tag,
+            self->priv->modal_day_width,
+            self->priv->hypoglycemia, self->priv->hyperglycemia));
 }
 
+static void
+update_chart_thresholds (OgDeviceWidget *self)
+{
+  if (self->priv->modal_day_chart != NULL)
+    og_modal_day_chart_set_thresholds (self->priv->modal_day_chart,
+        self->priv->hypoglycemia, self->priv->hyperglycemia);
+}
+
+#endif /* ENABLE_WEBKIT */
+
+
 static GtkWidget *
-chart_view_new (OgDeviceWidget *self)
+episode_row_new (const OgEpisode *episode)
 {
-  WebKitWebView *view;
-  gchar *basedir;
-  GBytes *bytes;
-  GError *error = NULL;
+  GDateTime *start;
+  gchar *start_str;
+  gchar *text;
+  GtkWidget *label;
+
+  start = g_date_time_new_from_unix_local (episode->start);
+  start_str = g_date_time_format (start, "%x %H:%M");
+
+  text = g_strdup_printf (
+      episode->kind == OG_EPISODE_HYPOGLYCEMIA ?
+          _("%s: hypoglycemia for %u min, nadir %u mg/dl") :
+          _("%s: hyperglycemia for %u min, peak %u mg/dl"),
+      start_str, (guint) ((episode->end - episode->start) / 60),
+      episode->extreme);
+  label = gtk_label_new (text);
+  gtk_widget_set_halign (label, GTK_ALIGN_START);
+  gtk_widget_show (label);
+
+  g_free (text);
+  g_free (start_str);
+  g_date_time_unref (start);
+
+  return label;
+}
+
+static void
+update_episodes (OgDeviceWidget *self)
+{
+  const OgEpisode *episodes;
+  guint n_episodes;
+  guint n_hypo = 0;
+  guint i;
+  gchar *text;
+
+  episodes = og_base_device_get_episodes (self->priv->device,
+      self->priv->time_span,
+      self->priv->hypoglycemia, self->priv->hyperglycemia,
+      self->priv->episode_max_gap, &n_episodes);
 
-  view = (WebKitWebView *) webkit_web_view_new ();
+  for (i = 0; i < n_episodes; i++)
+    {
+      if (episodes[i].kind == OG_EPISODE_HYPOGLYCEMIA)
+        n_hypo++;
+    }
+
+  text = g_strdup_printf (_("Episodes: %u hypoglycemia, %u hyperglycemia"),
+      n_hypo, n_episodes - n_hypo);
+  gtk_expander_set_label (GTK_EXPANDER (self->priv->episodes_expander), text);
+  g_free (text);
+
+  /* Most recent first */
+  gtk_container_foreach (GTK_CONTAINER (self->priv->episodes_list),
+      (GtkCallback) gtk_widget_destroy, NULL);
+  for (i = 0; i < MIN (n_episodes, MAX_LISTED_EPISODES); i++)
+    gtk_container_add (GTK_CONTAINER (self->priv->episodes_list),
+        episode_row_new (&episodes[n_episodes - 1 - i]));
+}
+
+static void
+update_meals_summary (OgDeviceWidget *self,
+    const OgSpanStats *span_stats)
+{
+  static const gchar *names[OG_N_MEAL_TAGS] = {
+    N_("untagged"),    /* OG_MEAL_TAG_NONE */
+    N_("fasting"),     /* OG_MEAL_TAG_FASTING */
+    N_("before meal"), /* OG_MEAL_TAG_BEFORE */
+    N_("after meal"),  /* OG_MEAL_TAG_AFTER */
+  };
+  GString *string;
+  guint i;
 
-  g_object_set (webkit_web_view_get_settings (view),
-      "enable-developer-extras", TRUE, NULL);
+  /* Untagged readings are already in the overall mean */
+  string = g_string_new (NULL);
+  for (i = OG_MEAL_TAG_FASTING; i < OG_N_MEAL_TAGS; i++)
+    {
+      const OgMoments *moments = &span_stats->meals[i];
 
-  basedir = dup_basedir ();
-  bytes = g_resources_lookup_data (
-      "/org/freedesktop/OpenGlucose/src/chart.html",
-      G_RESOURCE_LOOKUP_FLAGS_NONE,
-      &error);
-  g_assert_no_error (error);
-  g_assert (bytes != NULL);
+      if (moments->n_values == 0)
+        continue;
 
-  webkit_web_view_load_html (view,
-      g_bytes_get_data (bytes, NULL),
-      basedir);
+      if (string->len > 0)
+        g_string_append (string, ", ");
+      g_string_append_printf (string, _("%s %.0f mg/dl (%u)"),
+          _(names[i]), moments->mean, moments->n_values);
+    }
+  if (string->len == 0)
+    g_string_append (string, "-");
 
-  self->priv->n_loading_views++;
-  g_signal_connect (view, "notify::is-loading",
-      G_CALLBACK (view_is_loading_notify_cb), self);
+  gtk_label_set_text (GTK_LABEL (self->priv->meals_label), string->str);
+  g_string_free (string, TRUE);
+}
 
-  g_free (basedir);
-  g_bytes_unref (bytes);
+static void
+update_summary (OgDeviceWidget *self)
+{
+  OgStats *stats;
+  const OgSpanStats *span_stats;
+  const OgMoments *moments;
+  const OgVariability *variability;
+  guint n_hypo, n_good, n_hyper, n_values;
+  gchar *text;
+
+  stats = og_base_device_get_stats (self->priv->device);
+  span_stats = og_stats_get_span (stats, self->priv->time_span);
+  moments = &span_stats->moments;
+
+  if (moments->n_values == 0)
+    {
+      gtk_label_set_text (GTK_LABEL (self->priv->mean_label), "-");
+      gtk_label_set_text (GTK_LABEL (self->priv->sd_label), "-");
+      gtk_label_set_text (GTK_LABEL (self->priv->a1c_label), "-");
+      gtk_label_set_text (GTK_LABEL (self->priv->time_in_range_label), "-");
+      gtk_label_set_text (GTK_LABEL (self->priv->variability_label), "-");
+      gtk_label_set_text (GTK_LABEL (self->priv->meals_label), "-");
+      return;
+    }
 
-  return (GtkWidget *) view;
+  text = g_strdup_printf (_("%.0f mg/dl (%u to %u)"), moments->mean,
+      span_stats->min, span_stats->max);
+  gtk_label_set_text (GTK_LABEL (self->priv->mean_label), text);
+  g_free (text);
+
+  text = g_strdup_printf (_("%.0f mg/dl (CV %.0f%%)"),
+      og_moments_get_sd (moments), og_moments_get_cv (moments));
+  gtk_label_set_text (GTK_LABEL (self->priv->sd_label), text);
+  g_free (text);
+
+  text = g_strdup_printf (_("%.1f%% / %.1f%%"),
+      og_glycemia_get_gmi (moments->mean),
+      og_glycemia_get_ea1c (moments->mean));
+  gtk_label_set_text (GTK_LABEL (self->priv->a1c_label), text);
+  g_free (text);
+
+  og_stats_classify (stats, self->priv->time_span,
+      self->priv->hypoglycemia, self->priv->hyperglycemia,
+      &n_hypo, &n_good, &n_hyper);
+  n_values = n_hypo + n_good + n_hyper;
+  text = g_strdup_printf (_("%.0f%% (%.0f%% below, %.0f%% above)"),
+      100.0 * n_good / n_values,
+      100.0 * n_hypo / n_values,
+      100.0 * n_hyper / n_values);
+  gtk_label_set_text (GTK_LABEL (self->priv->time_in_range_label), text);
+  g_free (text);
+
+  variability = og_base_device_get_variability (self->priv->device,
+      self->priv->time_span);
+  text = g_strdup_printf (
+      _("MAGE %.0f, CONGA %.0f, MODD %.0f, LBGI %.1f, HBGI %.1f"),
+      variability->mage, variability->conga, variability->modd,
+      variability->lbgi, variability->hbgi);
+  gtk_label_set_text (GTK_LABEL (self->priv->variability_label), text);
+  g_free (text);
+
+  update_meals_summary (self, span_stats);
 }
 
 static void
@@ -346,6 +965,35 @@ update_status (OgDeviceWidget *self)
     }
 }
 
+static void
+update_progress (OgDeviceWidget *self)
+{
+  gdouble progress;
+  guint n_received;
+  gchar *text;
+
+  progress = og_base_device_get_progress (self->priv->device, &n_received);
+  if (n_received == 0)
+    {
+      gtk_widget_hide (self->priv->progress_bar);
+      return;
+    }
+
+  text = g_strdup_printf (_("%u records"), n_received);
+
+  /* Until the device tells how many records there are */
+  if (progress > 0)
+    gtk_progress_bar_set_fraction (
+        GTK_PROGRESS_BAR (self->priv->progress_bar), progress);
+  else
+    gtk_progress_bar_pulse (GTK_PROGRESS_BAR (self->priv->progress_bar));
+  gtk_progress_bar_set_text (GTK_PROGRESS_BAR (self->priv->progress_bar),
+      text);
+  gtk_widget_show (self->priv->progress_bar);
+
+  g_free (text);
+}
+
 static void
 add_info_widget (OgDeviceWidget *self,
     GtkGrid *grid,
@@ -409,46 +1057,122 @@ static void
 time_span_button_clicked_cb (GtkWidget *button,
     OgDeviceWidget *self)
 {
-  gint64 *span;
-  gchar *data;
-
-  span = g_object_get_data (G_OBJECT (button), "og-time-span");
-  self->priv->time_span = *span;
-
-  data = dup_modal_day_data (self);
-  run_javascript (self, self->priv->modal_day_view,
-      "OgChartRePlot(%s);", data);
-  g_free (data);
-
-  data = dup_average_data (self);
-  run_javascript (self, self->priv->average_view,
-      "OgChartRePlot(%s);", data);
-  g_free (data);
+  self->priv->time_span = GPOINTER_TO_UINT (
+      g_object_get_data (G_OBJECT (button), "og-time-span"));
+  update_summary (self);
+  update_episodes (self);
+  update_charts (self, OG_CHART_DATA_MODAL_DAY | OG_CHART_DATA_AVERAGE);
 }
 
 static void
 add_time_span_button (OgDeviceWidget *self,
     GtkBox *box,
     const gchar *text,
-    gint64 span)
+    OgTimeSpan span)
 {
   GtkWidget *button;
-  gint64 *span_ptr;
 
   button = gtk_button_new_with_label (text);
   gtk_box_pack_start (box, button, FALSE, FALSE, 0);
   gtk_widget_show (button);
 
-  /* Cannot stuff the gint64 into a gpointer on 32bits systems */
-  span_ptr = g_new (gint64, 1);
-  *span_ptr = span;
-  g_object_set_data_full (G_OBJECT (button), "og-time-span", span_ptr, g_free);
+  g_object_set_data (G_OBJECT (button), "og-time-span",
+      GUINT_TO_POINTER (span));
 
   g_signal_connect (button, "clicked",
       G_CALLBACK (time_span_button_clicked_cb),
       self);
 }
 
+/* Thresholds cannot cross, each spin button stops at the other's value */
+static void
+update_threshold_ranges (OgDeviceWidget *self)
+{
+  gtk_spin_button_set_range (
+      GTK_SPIN_BUTTON (self->priv->hypoglycemia_spin_button),
+      0, self->priv->hyperglycemia);
+  gtk_spin_button_set_range (
+      GTK_SPIN_BUTTON (self->priv->hyperglycemia_spin_button),
+      self->priv->hypoglycemia, OG_GLYCEMIA_MAX);
+}
+
+static void
+threshold_value_changed_cb (GtkSpinButton *spin_button,
+    OgDeviceWidget *self)
+{
+  guint *threshold;
+
+  threshold = g_object_get_data (G_OBJECT (spin_button), "og-threshold");
+  *threshold = gtk_spin_button_get_value_as_int (spin_button);
+  update_threshold_ranges (self);
+
+  update_summary (self);
+  update_episodes (self);
+  update_chart_thresholds (self);
+  if (self->priv->timeline_chart != NULL)
+    og_timeline_chart_set_thresholds (self->priv->timeline_chart,
+        self->priv->hypoglycemia, self->priv->hyperglycemia);
+  if (self->priv->calendar_chart != NULL)
+    og_calendar_chart_set_calendar (self->priv->calendar_chart,
+        og_base_device_get_calendar (self->priv->device,
+            self->priv->hypoglycemia, self->priv->hyperglycemia));
+  update_charts (self, OG_CHART_DATA_AVERAGE);
+}
+
+static void
+modal_day_width_changed_cb (GtkComboBox *combo_box,
+    OgDeviceWidget *self)
+{
+  self->priv->modal_day_width = g_ascii_strtoull (
+      gtk_combo_box_get_active_id (combo_box), NULL, 10);
+  update_charts (self, OG_CHART_DATA_MODAL_DAY);
+}
+
+static void
+episode_max_gap_changed_cb (GtkComboBox *combo_box,
+    OgDeviceWidget *self)
+{
+  self->priv->episode_max_gap = g_ascii_strtoull (
+      gtk_combo_box_get_active_id (combo_box), NULL, 10) * 60;
+  update_episodes (self);
+}
+
+static void
+meal_tag_changed_cb (GtkComboBox *combo_box,
+    OgDeviceWidget *self)
+{
+  self->priv->meal_tag = g_ascii_strtoull (
+      gtk_combo_box_get_active_id (combo_box), NULL, 10);
+  update_charts (self, OG_CHART_DATA_MODAL_DAY);
+}
+
+static void
+calendar_mode_changed_cb (GtkComboBox *combo_box,
+    OgDeviceWidget *self)
+{
+  og_calendar_chart_set_mode (self->priv->calendar_chart,
+      g_ascii_strtoull (gtk_combo_box_get_active_id (combo_box), NULL, 10));
+}
+
+static GtkWidget *
+add_threshold_spin_button (OgDeviceWidget *self,
+    GtkGrid *grid,
+    const gchar *title,
+    guint *threshold)
+{
+  GtkWidget *spin_button;
+
+  spin_button = gtk_spin_button_new_with_range (0, OG_GLYCEMIA_MAX, 5);
+  gtk_spin_button_set_value (GTK_SPIN_BUTTON (spin_button), *threshold);
+  g_object_set_data (G_OBJECT (spin_button), "og-threshold", threshold);
+  g_signal_connect (spin_button, "value-changed",
+      G_CALLBACK (threshold_value_changed_cb), self);
+
+  add_info_widget_with_title (self, grid, title, spin_button);
+
+  return spin_button;
+}
+
 static void
 sync_clock_clicked_cb (GtkWidget *button,
     OgDeviceWidget *self)
@@ -472,6 +1196,9 @@ prepare_cb (GObject *source,
   GtkBox *top_box;
   GError *error = NULL;
 
+  og_trace_async_end (device, "prepare");
+  og_trace_mark ("prepare_cb() for %s", og_base_device_get_name (device));
+
   if (!og_base_device_prepare_finish (device, result, &error))
     {
       g_warning ("Error preparing device: %s", error->message);
@@ -503,14 +1230,103 @@ prepare_cb (GObject *source,
 
   /* Info: time span selector */
   w = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
-  add_time_span_button (self, GTK_BOX (w), _("1W"),   7*G_TIME_SPAN_DAY);
-  add_time_span_button (self, GTK_BOX (w), _("2W"),  14*G_TIME_SPAN_DAY);
-  add_time_span_button (self, GTK_BOX (w), _("1M"),  30*G_TIME_SPAN_DAY);
-  add_time_span_button (self, GTK_BOX (w), _("2M"),  60*G_TIME_SPAN_DAY);
-  add_time_span_button (self, GTK_BOX (w), _("1Y"), 365*G_TIME_SPAN_DAY);
-  add_time_span_button (self, GTK_BOX (w), _("All"), -1);
+  add_time_span_button (self, GTK_BOX (w), _("1W"), OG_TIME_SPAN_1W);
+  add_time_span_button (self, GTK_BOX (w), _("2W"), OG_TIME_SPAN_2W);
+  add_time_span_button (self, GTK_BOX (w), _("1M"), OG_TIME_SPAN_1M);
+  add_time_span_button (self, GTK_BOX (w), _("2M"), OG_TIME_SPAN_2M);
+  add_time_span_button (self, GTK_BOX (w), _("1Y"), OG_TIME_SPAN_1Y);
+  add_time_span_button (self, GTK_BOX (w), _("All"), OG_TIME_SPAN_ALL);
   add_info_widget_with_title (self, info_grid, _("Time span"), w);
 
+  /* Info: modal day resolution */
+  w = gtk_combo_box_text_new ();
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "15", _("15 minutes"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "30", _("30 minutes"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "60", _("1 hour"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "120", _("2 hours"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "0", _("Smoothed"));
+  gtk_combo_box_set_active_id (GTK_COMBO_BOX (w), "120");
+  g_signal_connect (w, "changed",
+      G_CALLBACK (modal_day_width_changed_cb), self);
+  add_info_widget_with_title (self, info_grid, _("Modal day"), w);
+
+  /* Info: modal day readings, ids are OgMealTag values */
+  w = gtk_combo_box_text_new ();
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "4", _("All"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "1", _("Fasting"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "2", _("Before meal"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "3", _("After meal"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "0", _("Untagged"));
+  gtk_combo_box_set_active_id (GTK_COMBO_BOX (w), "4");
+  g_signal_connect (w, "changed",
+      G_CALLBACK (meal_tag_changed_cb), self);
+  add_info_widget_with_title (self, info_grid, _("Readings"), w);
+
+  /* Info: calendar colors, ids are OgCalendarMode values */
+  w = gtk_combo_box_text_new ();
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "0", _("Time in range"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "1", _("Mean glucose"));
+  gtk_combo_box_set_active_id (GTK_COMBO_BOX (w), "0");
+  g_signal_connect (w, "changed",
+      G_CALLBACK (calendar_mode_changed_cb), self);
+  add_info_widget_with_title (self, info_grid, _("Calendar"), w);
+
+  /* Info: thresholds */
+  self->priv->hypoglycemia_spin_button = add_threshold_spin_button (self,
+      info_grid, _("Hypoglycemia (mg/dl)"), &self->priv->hypoglycemia);
+  self->priv->hyperglycemia_spin_button = add_threshold_spin_button (self,
+      info_grid, _("Hyperglycemia (mg/dl)"), &self->priv->hyperglycemia);
+  update_threshold_ranges (self);
+
+  /* Info: summary statistics of the time span */
+  self->priv->mean_label = gtk_label_new (NULL);
+  add_info_widget_with_title (self, info_grid, _("Mean glucose"),
+      self->priv->mean_label);
+  self->priv->sd_label = gtk_label_new (NULL);
+  add_info_widget_with_title (self, info_grid, _("Standard deviation"),
+      self->priv->sd_label);
+  self->priv->a1c_label = gtk_label_new (NULL);
+  add_info_widget_with_title (self, info_grid, _("GMI / eA1c"),
+      self->priv->a1c_label);
+  self->priv->time_in_range_label = gtk_label_new (NULL);
+  add_info_widget_with_title (self, info_grid, _("Time in range"),
+      self->priv->time_in_range_label);
+  self->priv->variability_label = gtk_label_new (NULL);
+  add_info_widget_with_title (self, info_grid, _("Variability"),
+      self->priv->variability_label);
+  self->priv->meals_label = gtk_label_new (NULL);
+  add_info_widget_with_title (self, info_grid, _("Mean by meal"),
+      self->priv->meals_label);
+
+  /* Info: episode gap tolerance, ids are in minutes */
+  w = gtk_combo_box_text_new ();
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "15", _("15 minutes"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "30", _("30 minutes"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "60", _("1 hour"));
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (w), "120", _("2 hours"));
+  gtk_combo_box_set_active_id (GTK_COMBO_BOX (w), "30");
+  g_signal_connect (w, "changed",
+      G_CALLBACK (episode_max_gap_changed_cb), self);
+  add_info_widget_with_title (self, info_grid, _("Episode gap"), w);
+
+  /* Info: episodes list */
+  self->priv->episodes_expander = gtk_expander_new (NULL);
+  w = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (w),
+      GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_widget_set_size_request (w, -1, 150);
+  gtk_container_add (GTK_CONTAINER (self->priv->episodes_expander), w);
+  gtk_widget_show (w);
+  self->priv->episodes_list = gtk_list_box_new ();
+  gtk_list_box_set_selection_mode (GTK_LIST_BOX (self->priv->episodes_list),
+      GTK_SELECTION_NONE);
+  gtk_container_add (GTK_CONTAINER (w), self->priv->episodes_list);
+  gtk_widget_show (self->priv->episodes_list);
+  add_info_widget (self, info_grid, self->priv->episodes_expander);
+
+  update_summary (self);
+  update_episodes (self);
+
   /* Info: serial number */
   add_info (self, info_grid, _("Serial number"),
       og_base_device_get_serial_number (self->priv->device));
@@ -527,19 +1343,54 @@ prepare_cb (GObject *source,
   add_info_widget (self, info_grid, w);
 
   /* top-right pie hyper/good/hypo percentages chart */
-  w = chart_view_new (self);
+  w = create_average_chart (self);
   gtk_widget_set_size_request (w, -1, 350);
   gtk_box_pack_start (top_box, w, TRUE, TRUE, 0);
   gtk_widget_set_hexpand (w, TRUE),
   gtk_widget_show (w);
-  self->priv->average_view = (WebKitWebView *) w;
 
   /* bottom modal day chart */
-  w = chart_view_new (self);
+  w = create_modal_day_chart (self);
   gtk_widget_set_size_request (w, -1, 350);
   gtk_box_pack_start (GTK_BOX (self->priv->main_vbox), w, FALSE, FALSE, 0);
   gtk_widget_show (w);
-  self->priv->modal_day_view = (WebKitWebView *) w;
+
+  /* bottom timeline of the whole history, zoomed with the wheel and panned by
+   * dragging */
+  w = og_timeline_chart_new ();
+  self->priv->timeline_chart = (OgTimelineChart *) w;
+  og_timeline_chart_set_thresholds (self->priv->timeline_chart,
+      self->priv->hypoglycemia, self->priv->hyperglycemia);
+  og_timeline_chart_set_timeline (self->priv->timeline_chart,
+      og_base_device_get_timeline (self->priv->device));
+  gtk_widget_set_size_request (w, -1, 250);
+  gtk_box_pack_start (GTK_BOX (self->priv->main_vbox), w, FALSE, FALSE, 0);
+  gtk_widget_show (w);
+
+  /* bottom calendar of the whole history, a column per week */
+  w = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (w),
+      GTK_POLICY_AUTOMATIC, GTK_POLICY_NEVER);
+  gtk_box_pack_start (GTK_BOX (self->priv->main_vbox), w, FALSE, FALSE, 0);
+  gtk_widget_show (w);
+  self->priv->calendar_chart = (OgCalendarChart *) og_calendar_chart_new ();
+  og_calendar_chart_set_calendar (self->priv->calendar_chart,
+      og_base_device_get_calendar (self->priv->device,
+          self->priv->hypoglycemia, self->priv->hyperglycemia));
+  gtk_container_add (GTK_CONTAINER (w),
+      (GtkWidget *) self->priv->calendar_chart);
+  gtk_widget_show ((GtkWidget *) self->priv->calendar_chart);
+
+  /* Web views ask for data once loaded */
+  update_charts (self, OG_CHART_DATA_MODAL_DAY | OG_CHART_DATA_AVERAGE);
+
+#ifdef ENABLE_WEBKIT
+  /* Snapshots saved by previous runs, until the charts are plotted */
+  og_chart_snapshots_load_async (
+      og_base_device_get_serial_number (self->priv->device),
+      self->priv->views_cancellable, snapshots_loaded_cb,
+      g_object_ref (self));
+#endif
 
   g_free (device_clock_str);
   g_free (system_clock_str);
@@ -551,7 +1402,15 @@ og_device_widget_init (OgDeviceWidget *self)
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
       OG_TYPE_DEVICE_WIDGET, OgDeviceWidgetPrivate);
 
-  self->priv->time_span = -1;
+  self->priv->time_span = OG_TIME_SPAN_ALL;
+  self->priv->modal_day_width = 120;
+  self->priv->meal_tag = OG_MEAL_TAG_ANY;
+  self->priv->hypoglycemia = OG_HYPOGLYCEMIA;
+  self->priv->hyperglycemia = OG_HYPERGLYCEMIA;
+  self->priv->episode_max_gap = OG_EPISODE_MAX_GAP;
+#ifdef ENABLE_WEBKIT
+  self->priv->views_cancellable = g_cancellable_new ();
+#endif
 }
 
 static void
@@ -603,6 +1462,8 @@ constructed (GObject *object)
 
   g_assert (self->priv->device != NULL);
 
+  og_trace_async_begin (self->priv->device, "prepare", "%s",
+      og_base_device_get_name (self->priv->device));
   og_base_device_prepare_async (self->priv->device, NULL,
       prepare_cb, self);
 
@@ -620,6 +1481,17 @@ constructed (GObject *object)
   gtk_container_add (GTK_CONTAINER (content_area), self->priv->info_bar_label);
   gtk_widget_show (self->priv->info_bar_label);
 
+  self->priv->progress_bar = gtk_progress_bar_new ();
+  gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (self->priv->progress_bar),
+      TRUE);
+  gtk_widget_set_hexpand (self->priv->progress_bar, TRUE);
+  gtk_widget_set_valign (self->priv->progress_bar, GTK_ALIGN_CENTER);
+  gtk_container_add (GTK_CONTAINER (content_area), self->priv->progress_bar);
+
+  g_signal_connect_object (self->priv->device, "notify::progress",
+      G_CALLBACK (update_progress), self, G_CONNECT_SWAPPED);
+  update_progress (self);
+
   g_signal_connect_object (self->priv->device, "notify::status",
       G_CALLBACK (update_status), self, G_CONNECT_SWAPPED);
   update_status (self);
@@ -638,6 +1510,17 @@ dispose (GObject *object)
 {
   OgDeviceWidget *self = (OgDeviceWidget *) object;
 
+#ifdef ENABLE_WEBKIT
+  if (self->priv->chart_data_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->priv->chart_data_cancellable);
+      g_clear_object (&self->priv->chart_data_cancellable);
+    }
+  g_cancellable_cancel (self->priv->views_cancellable);
+  g_clear_object (&self->priv->views_cancellable);
+  clear_chart_updates (&self->priv->modal_day_updates);
+  clear_chart_updates (&self->priv->average_updates);
+#endif
   g_clear_object (&self->priv->device);
 
   G_OBJECT_CLASS (og_device_widget_parent_class)->dispose (object);
@@ -664,6 +1547,28 @@ og_device_widget_class_init (OgDeviceWidgetClass *klass)
   g_object_class_install_property (object_class, PROP_DEVICE, param_spec);
 }
 
+/* WebKit views render in a separate web process whose memory cannot be
+ * measured from here, only the chart scripts we keep feeding them are
+ * accounted. Native charts only keep a copy of the readings of the span. */
+void
+og_device_widget_account_memory (OgDeviceWidget *self,
+    OgMemoryUsage *usage)
+{
+  g_return_if_fail (OG_IS_DEVICE_WIDGET (self));
+  g_return_if_fail (usage != NULL);
+
+  og_memory_usage_add (usage, "widget", sizeof (OgDeviceWidgetPrivate));
+  og_memory_usage_add (usage, "calendar tiles",
+      og_calendar_chart_get_size (self->priv->calendar_chart));
+#ifdef ENABLE_WEBKIT
+  og_memory_usage_add (usage, "chart scripts",
+      self->priv->modal_day_script_size + self->priv->average_script_size);
+#else
+  og_memory_usage_add (usage, "chart data",
+      og_modal_day_chart_get_size (self->priv->modal_day_chart));
+#endif
+}
+
 GtkWidget *
 og_device_widget_new (OgBaseDevice *device)
 {
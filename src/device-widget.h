@@ -41,6 +41,9 @@ GType og_device_widget_get_type (void) G_GNUC_CONST;
 
 GtkWidget *og_device_widget_new (OgBaseDevice *device);
 
+void og_device_widget_account_memory (OgDeviceWidget *self,
+    OgMemoryUsage *usage);
+
 G_END_DECLS
 
 #endif /* __OG_DEVICE_WIDGET_H__ */
@@ -39,19 +39,22 @@ prepare_timeout_cb (gpointer user_data)
   while (g_date_time_compare (dt, now) < 0)
     {
       GDateTime *tmp;
+      OgRecord *record;
       gdouble delta;
 
       delta = 5 - log2 (g_rand_double_range (rand, 1, (1 << 5) + 1));
       delta *= g_rand_boolean (rand) ? 1 : -1;
       delta *= 20;
 
-      g_ptr_array_add (self->priv->records, og_record_new (
+      record = og_record_new (
           g_date_time_get_year (dt),
           g_date_time_get_month (dt),
           g_date_time_get_day_of_month (dt),
           g_date_time_get_hour (dt),
           g_rand_int_range (rand, 0, 60),
-          115 + (int) delta));
+          115 + (int) delta);
+      record->meal_tag = g_rand_int_range (rand, 0, OG_N_MEAL_TAGS);
+      g_ptr_array_add (self->priv->records, record);
 
       tmp = g_date_time_add_hours (dt, g_rand_int_range (rand, 1, 13));
       g_date_time_unref (dt);
@@ -0,0 +1,177 @@
+#include "config.h"
+
+#include "episodes.h"
+
+struct _OgEpisodeDetector
+{
+  guint hypoglycemia;
+  guint hyperglycemia;
+  gint64 max_gap;
+
+  /* GArray<OgEpisode>, only the last one can be ongoing */
+  GArray *episodes;
+  gint64 last_time;
+  gboolean has_readings;
+};
+
+OgEpisodeDetector *
+og_episode_detector_new (guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap)
+{
+  OgEpisodeDetector *self;
+
+  g_return_val_if_fail (hypoglycemia <= hyperglycemia, NULL);
+  g_return_val_if_fail (max_gap >= 0, NULL);
+
+  self = g_slice_new0 (OgEpisodeDetector);
+  self->hypoglycemia = hypoglycemia;
+  self->hyperglycemia = hyperglycemia;
+  self->max_gap = max_gap;
+  self->episodes = g_array_new (FALSE, FALSE, sizeof (OgEpisode));
+
+  return self;
+}
+
+void
+og_episode_detector_free (OgEpisodeDetector *self)
+{
+  if (self == NULL)
+    return;
+
+  g_array_unref (self->episodes);
+  g_slice_free (OgEpisodeDetector, self);
+}
+
+gsize
+og_episode_detector_get_size (const OgEpisodeDetector *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return sizeof (OgEpisodeDetector) +
+      self->episodes->len * sizeof (OgEpisode);
+}
+
+gboolean
+og_episode_detector_has_settings (const OgEpisodeDetector *self,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return self->hypoglycemia == hypoglycemia &&
+      self->hyperglycemia == hyperglycemia &&
+      self->max_gap == max_gap;
+}
+
+/* Time of the last reading added, G_MININT64 if none */
+gint64
+og_episode_detector_get_last_time (const OgEpisodeDetector *self)
+{
+  g_return_val_if_fail (self != NULL, G_MININT64);
+
+  return self->has_readings ? self->last_time : G_MININT64;
+}
+
+static OgEpisode *
+get_ongoing (OgEpisodeDetector *self)
+{
+  OgEpisode *episode;
+
+  if (self->episodes->len == 0)
+    return NULL;
+
+  episode = &g_array_index (self->episodes, OgEpisode,
+      self->episodes->len - 1);
+
+  return episode->ongoing ? episode : NULL;
+}
+
+/* @time is in seconds and must not be before the previous reading */
+void
+og_episode_detector_add (OgEpisodeDetector *self,
+    gint64 time,
+    guint glycemia)
+{
+  OgEpisode *episode;
+  OgEpisodeKind kind;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (!self->has_readings || time >= self->last_time);
+
+  self->last_time = time;
+  self->has_readings = TRUE;
+
+  episode = get_ongoing (self);
+  if (episode != NULL && time - episode->end > self->max_gap)
+    {
+      episode->ongoing = FALSE;
+      episode = NULL;
+    }
+
+  if (glycemia < self->hypoglycemia)
+    kind = OG_EPISODE_HYPOGLYCEMIA;
+  else if (glycemia >= self->hyperglycemia)
+    kind = OG_EPISODE_HYPERGLYCEMIA;
+  else
+    return;
+
+  if (episode != NULL && episode->kind != kind)
+    {
+      episode->ongoing = FALSE;
+      episode = NULL;
+    }
+
+  if (episode == NULL)
+    {
+      OgEpisode new_episode;
+
+      new_episode.kind = kind;
+      new_episode.start = time;
+      new_episode.end = time;
+      new_episode.extreme = glycemia;
+      new_episode.n_readings = 1;
+      new_episode.ongoing = TRUE;
+      g_array_append_val (self->episodes, new_episode);
+
+      return;
+    }
+
+  episode->end = time;
+  episode->n_readings++;
+  if (kind == OG_EPISODE_HYPOGLYCEMIA)
+    episode->extreme = MIN (episode->extreme, glycemia);
+  else
+    episode->extreme = MAX (episode->extreme, glycemia);
+}
+
+/* Returns the episodes that ended at or after @since, in O(log n) */
+const OgEpisode *
+og_episode_detector_get_since (const OgEpisodeDetector *self,
+    gint64 since,
+    guint *n_episodes)
+{
+  const OgEpisode *episodes;
+  guint lo = 0;
+  guint hi;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (n_episodes != NULL, NULL);
+
+  episodes = (const OgEpisode *) self->episodes->data;
+  hi = self->episodes->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (episodes[mid].end < since)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  *n_episodes = self->episodes->len - lo;
+
+  return episodes + lo;
+}
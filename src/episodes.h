@@ -0,0 +1,61 @@
+#ifndef __OG_EPISODES_H__
+#define __OG_EPISODES_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Default time, in seconds, after the last out of range reading for an
+ * episode to end */
+#define OG_EPISODE_MAX_GAP (30 * 60)
+
+typedef enum
+{
+  OG_EPISODE_HYPOGLYCEMIA,
+  OG_EPISODE_HYPERGLYCEMIA,
+} OgEpisodeKind;
+
+typedef struct
+{
+  OgEpisodeKind kind;
+  /* Unix times of the first and last out of range readings */
+  gint64 start;
+  gint64 end;
+  /* Nadir of hypoglycemia or peak of hyperglycemia, in mg/dl */
+  guint extreme;
+  guint n_readings;
+  /* The last reading is not @max_gap past the end yet */
+  gboolean ongoing;
+} OgEpisode;
+
+/* Groups out of range readings, added in time order, into episodes. An
+ * episode continues through in range readings as long as the next out of
+ * range reading of the same kind is within @max_gap of the previous one, and
+ * ends when the opposite kind is reached. Episodes are stored in time order
+ * and do not overlap. */
+typedef struct _OgEpisodeDetector OgEpisodeDetector;
+
+OgEpisodeDetector *og_episode_detector_new (guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap);
+void og_episode_detector_free (OgEpisodeDetector *self);
+gsize og_episode_detector_get_size (const OgEpisodeDetector *self);
+
+gboolean og_episode_detector_has_settings (const OgEpisodeDetector *self,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    gint64 max_gap);
+gint64 og_episode_detector_get_last_time (const OgEpisodeDetector *self);
+
+void og_episode_detector_add (OgEpisodeDetector *self,
+    gint64 time,
+    guint glycemia);
+
+const OgEpisode *og_episode_detector_get_since (
+    const OgEpisodeDetector *self,
+    gint64 since,
+    guint *n_episodes);
+
+G_END_DECLS
+
+#endif /* __OG_EPISODES_H__ */
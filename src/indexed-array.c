@@ -0,0 +1,50 @@
+#include "config.h"
+
+#include "indexed-array.h"
+
+#include <string.h>
+
+/* Rounds towards minus infinity, unlike the / operator, so times before the
+ * epoch get negative indexes too */
+gint64
+og_div_floor (gint64 a,
+    gint64 b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+gpointer
+og_indexed_array_get (GArray *array,
+    gint64 *first,
+    gint64 index)
+{
+  guint element_size;
+
+  g_return_val_if_fail (array != NULL, NULL);
+  g_return_val_if_fail (first != NULL, NULL);
+
+  element_size = g_array_get_element_size (array);
+
+  if (array->len == 0)
+    *first = index;
+
+  if (index < *first)
+    {
+      guint len = array->len;
+      guint n;
+
+      /* Grow backwards at least by what is already there, so elements got
+       * in decreasing index order still take amortized constant time */
+      n = MAX (*first - index, len);
+      g_array_set_size (array, n + len);
+      memmove (array->data + n * element_size, array->data,
+          len * element_size);
+      memset (array->data, 0, n * element_size);
+      *first -= n;
+    }
+
+  if (index - *first >= array->len)
+    g_array_set_size (array, index - *first + 1);
+
+  return array->data + (index - *first) * element_size;
+}
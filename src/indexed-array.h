@@ -0,0 +1,21 @@
+#ifndef __OG_INDEXED_ARRAY_H__
+#define __OG_INDEXED_ARRAY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A GArray of zero-initialized elements covering a range of signed indexes,
+ * e.g. days or time buckets since the Unix epoch, whose first element is at
+ * index *@first. Getting any index grows the array to it, in either
+ * direction. */
+gpointer og_indexed_array_get (GArray *array,
+    gint64 *first,
+    gint64 index);
+
+gint64 og_div_floor (gint64 a,
+    gint64 b);
+
+G_END_DECLS
+
+#endif /* __OG_INDEXED_ARRAY_H__ */
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "trace.h"
+
 /* Abbott FreeStyle InsuLinx reverse-engineered protocol.
  *
  * This is based on USB logs of 'auto-assist' Windows application, captured
@@ -82,6 +84,7 @@ typedef struct
   guint8 code;
   gchar *cmd;
   ParserFunc parser;
+  gint64 sent_time;
 } Request;
 
 struct _OgInsulinxPrivate
@@ -108,6 +111,8 @@ struct _OgInsulinxPrivate
   GDateTime *device_clock;
   GDateTime *system_clock;
   GPtrArray *records;
+  /* Lines of the $result? reply received so far */
+  guint n_results;
   gchar *first_name;
   gchar *last_name;
 
@@ -241,6 +246,9 @@ request_queue_continue (OgInsulinx *self)
 
   /* Send the request */
   DEBUG_MSG ("Sent", self->priv->req->code, self->priv->req->cmd);
+  og_trace_async_begin (self->priv->req, "request", "0x%02x %s",
+      self->priv->req->code, self->priv->req->cmd);
+  self->priv->req->sent_time = g_get_monotonic_time ();
   g_usb_device_control_transfer_async (self->priv->usb_device,
       G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
       G_USB_DEVICE_REQUEST_TYPE_CLASS,
@@ -279,9 +287,30 @@ request_free (Request *req)
   g_slice_free (Request, req);
 }
 
+/* Name under which latencies of this request are accounted: the init
+ * requests are named by their code, and "$foo?\r\n" or "$foo,value\r\n"
+ * commands by "$foo?" or "$foo". */
+static gchar *
+dup_request_name (Request *req)
+{
+  if (req->code != 0x60)
+    return g_strdup_printf ("0x%02x", req->code);
+
+  return g_strndup (req->cmd, strcspn (req->cmd, ",\r\n"));
+}
+
 static void
 request_done (OgInsulinx *self)
 {
+  gchar *name;
+
+  og_trace_async_end (self->priv->req, "request");
+
+  name = dup_request_name (self->priv->req);
+  og_base_device_metrics_command_done ((OgBaseDevice *) self, name,
+      g_get_monotonic_time () - self->priv->req->sent_time);
+  g_free (name);
+
   g_clear_pointer (&self->priv->req, request_free);
   self->priv->cksm_received = FALSE;
   self->priv->cksm = 0;
@@ -370,6 +399,7 @@ parser_common (OgInsulinx *self,
           /* We received the checksum */
           if (cksm != self->priv->cksm)
             {
+              og_base_device_metrics_checksum_failed ((OgBaseDevice *) self);
               report_error (self, g_error_new (OG_BASE_DEVICE_ERROR,
                   OG_BASE_DEVICE_ERROR_PARSER,
                   "Checksum mismatch: expected %x, calculated %x",
@@ -453,6 +483,8 @@ interrupt_transfer_cb (GObject *source,
   msg = (gchar *) self->priv->receive_buffer + 2;
   msg[msg_len] = '\0';
 
+  og_base_device_metrics_frame_received ((OgBaseDevice *) self, msg_len + 2);
+
   DEBUG_MSG ("Received", code, msg);
   parser_common (self, code, msg);
 
@@ -555,7 +587,10 @@ parse_init_first (OgInsulinx *self,
   /* We could be receiving replies from a previous request that made the app
    * crash and restart. Ignore them until we receive what we want. */
   if (code != 0x34)
-    return;
+    {
+      og_base_device_metrics_retried ((OgBaseDevice *) self);
+      return;
+    }
 
   /* FIXME: What's the meaning of this message? In windows logs, msg[0] == 0xc
    * but here I get 0xd. Why? */
@@ -666,29 +701,67 @@ parse_time (OgInsulinx *self,
       hour, minute, 0);
 }
 
+/* Matches the "Meal Taken Time" column of exports by the vendor software, see
+ * data/insulinx/export.csv. FIXME: Meaning of values is inferred from the
+ * time of tagged readings. */
+static OgMealTag
+meal_tag_from_meal_taken_time (guint meal_taken_time)
+{
+  switch (meal_taken_time)
+    {
+      case 0:
+        return OG_MEAL_TAG_FASTING;
+      case 1:
+        return OG_MEAL_TAG_BEFORE;
+      case 2:
+        return OG_MEAL_TAG_AFTER;
+      default:
+        return OG_MEAL_TAG_NONE;
+    }
+}
+
 static void
 parse_result (OgInsulinx *self,
     guint8 code,
     const gchar *msg)
 {
-  guint type, month, day, year, hour, minute, glycemia;
+  guint type, record_number, month, day, year, hour, minute, glycemia;
+  guint meal_taken_time, ketone, smart_tag;
+  guint n_results;
   guint ignore;
+  gchar end;
+  OgRecord *record;
   gint n_parsed;
 
+  /* The last line is the number of results, followed by what looks like a
+   * checksum of them. FIXME: That number comes only after all results, and
+   * no other command seems to tell it, so until then the total is
+   * unknown. */
+  if (sscanf (msg, "%u,%8x%c", &n_results, &ignore, &end) == 2)
+    {
+      og_base_device_update_progress ((OgBaseDevice *) self,
+          n_results, MAX (n_results, 1));
+      return;
+    }
+
+  self->priv->n_results++;
+  og_base_device_update_progress ((OgBaseDevice *) self,
+      self->priv->n_results, 0);
+
   n_parsed = sscanf (msg, "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
       &type,
-      &ignore, /* Record Number */
+      &record_number,
       &month, &day, &year,
       &hour, &minute,
       &ignore, /* FIXME: What is that? */
       &ignore, /* FIXME: What is that? */
       &ignore, /* FIXME: What is that? */
       &ignore, /* FIXME: What is that? */
-      &ignore, /* FIXME: What is that? */
+      &meal_taken_time,
       &ignore, /* FIXME: What is that? */
       &glycemia,
-      &ignore, /* FIXME: What is that? */
-      &ignore); /* FIXME: What is that? */
+      &ketone,
+      &smart_tag);
 
   /* FIXME: Not sure what are those results */
   if (type != 0)
@@ -705,8 +778,13 @@ parse_result (OgInsulinx *self,
   /* Fix 2 digits year */
   year += 2000;
 
-  ptr_array_add_null_term (self->priv->records,
-      og_record_new (year, month, day, hour, minute, glycemia));
+  record = og_record_new (year, month, day, hour, minute, glycemia);
+  record->meal_tag = meal_tag_from_meal_taken_time (meal_taken_time);
+  record->ketone = ketone;
+  record->smart_tag = smart_tag;
+  ptr_array_add_null_term (self->priv->records, record);
+  og_trace_counter ("records", self->priv->records->len - 1);
+  og_base_device_metrics_record_received ((OgBaseDevice *) self);
 }
 
 static void
@@ -744,6 +822,35 @@ parse_ptname (OgInsulinx *self,
   g_strfreev (names);
 }
 
+static gboolean
+open_usb_device (OgInsulinx *self,
+    GError **error)
+{
+  if (!g_usb_device_open (self->priv->usb_device, error))
+    return FALSE;
+
+  if (!g_usb_device_claim_interface (self->priv->usb_device, 0,
+          G_USB_DEVICE_CLAIM_INTERFACE_BIND_KERNEL_DRIVER,
+          error))
+    return FALSE;
+
+  if (!g_usb_device_set_configuration (self->priv->usb_device, 1, error))
+    return FALSE;
+
+  return g_usb_device_control_transfer (self->priv->usb_device,
+      G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
+      G_USB_DEVICE_REQUEST_TYPE_CLASS,
+      G_USB_DEVICE_RECIPIENT_INTERFACE,
+      0x0a, /* SET_IDLE */
+      0,
+      0,
+      NULL, 0,
+      NULL,
+      0,
+      self->priv->cancellable,
+      error);
+}
+
 static void
 prepare_async (OgBaseDevice *base,
     GCancellable *cancellable,
@@ -771,42 +878,14 @@ prepare_async (OgBaseDevice *base,
   g_assert (self->priv->task == NULL);
   self->priv->task = g_task_new (self, cancellable, callback, user_data);
 
-  if (!g_usb_device_open (self->priv->usb_device, &error))
-    {
-      report_error (self, error);
-      return;
-    }
-
-  if (!g_usb_device_claim_interface (self->priv->usb_device, 0,
-          G_USB_DEVICE_CLAIM_INTERFACE_BIND_KERNEL_DRIVER,
-          &error))
-    {
-      report_error (self, error);
-      return;
-    }
-
-  if (!g_usb_device_set_configuration (self->priv->usb_device, 1, &error))
-    {
-      report_error (self, error);
-      return;
-    }
-
-  if (!g_usb_device_control_transfer (self->priv->usb_device,
-          G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
-          G_USB_DEVICE_REQUEST_TYPE_CLASS,
-          G_USB_DEVICE_RECIPIENT_INTERFACE,
-          0x0a, /* SET_IDLE */
-          0,
-          0,
-          NULL, 0,
-          NULL,
-          0,
-          self->priv->cancellable,
-          &error))
+  og_trace_begin ("usb-open");
+  if (!open_usb_device (self, &error))
     {
+      og_trace_end ("usb-open");
       report_error (self, error);
       return;
     }
+  og_trace_end ("usb-open");
 
   /* Start pulling reply buffers, to get them as soon as one is ready */
   start_interrupt_transfer (self);
@@ -975,6 +1054,45 @@ get_last_name (OgBaseDevice *base)
   return self->priv->last_name;
 }
 
+static gsize
+strsize (const gchar *str)
+{
+  return str != NULL ? strlen (str) + 1 : 0;
+}
+
+static void
+account_memory (OgBaseDevice *base,
+    OgMemoryUsage *usage)
+{
+  OgInsulinx *self = (OgInsulinx *) base;
+  GList *l;
+
+  OG_BASE_DEVICE_CLASS (og_insulinx_parent_class)->account_memory (base,
+      usage);
+
+  og_memory_usage_add (usage, "device", sizeof (OgInsulinxPrivate) +
+      strsize (self->priv->serial_number) +
+      strsize (self->priv->sw_version) +
+      strsize (self->priv->first_name) +
+      strsize (self->priv->last_name));
+  og_memory_usage_add (usage, "reassembly buffer",
+      sizeof (GString) + self->priv->received->allocated_len);
+
+  if (self->priv->req != NULL)
+    og_memory_usage_add (usage, "request queue",
+        sizeof (Request) + strsize (self->priv->req->cmd));
+  for (l = self->priv->request_queue.head; l != NULL; l = l->next)
+    {
+      Request *req = l->data;
+
+      og_memory_usage_add (usage, "request queue",
+          sizeof (GList) + sizeof (Request) + strsize (req->cmd));
+    }
+
+  if (self->priv->device_clock != NULL)
+    og_memory_usage_add (usage, "device", 2 * OG_DATE_TIME_SIZE);
+}
+
 static void
 og_insulinx_class_init (OgInsulinxClass *klass)
 {
@@ -997,6 +1115,7 @@ og_insulinx_class_init (OgInsulinxClass *klass)
   base_class->get_records = get_records;
   base_class->get_first_name = get_first_name;
   base_class->get_last_name = get_last_name;
+  base_class->account_memory = account_memory;
 
   g_type_class_add_private (object_class, sizeof (OgInsulinxPrivate));
 
@@ -0,0 +1,287 @@
+#include "config.h"
+
+#include "kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define DEBUG g_debug
+
+typedef struct
+{
+  const gchar *name;
+  void (*min_max) (const guint16 *values,
+      gsize n_values,
+      guint16 *min,
+      guint16 *max);
+  void (*interleave) (const guint16 *first,
+      const guint16 *second,
+      gsize n_values,
+      guint16 *dest);
+} Kernels;
+
+/* Scalar fallback, also used for the tail of arrays by SIMD kernels */
+
+static void
+min_max_scalar (const guint16 *values,
+    gsize n_values,
+    guint16 *min,
+    guint16 *max)
+{
+  gsize i;
+
+  for (i = 0; i < n_values; i++)
+    {
+      *min = MIN (*min, values[i]);
+      *max = MAX (*max, values[i]);
+    }
+}
+
+static void
+interleave_scalar (const guint16 *first,
+    const guint16 *second,
+    gsize n_values,
+    guint16 *dest)
+{
+  gsize i;
+
+  for (i = 0; i < n_values; i++)
+    {
+      dest[2 * i] = first[i];
+      dest[2 * i + 1] = second[i];
+    }
+}
+
+static const Kernels scalar_kernels = {
+  "scalar",
+  min_max_scalar,
+  interleave_scalar,
+};
+
+#ifdef HAVE_X86_KERNELS
+
+/* SSE4.2 kernels, 8 values per vector */
+
+__attribute__ ((target ("sse4.2")))
+static void
+min_max_sse42 (const guint16 *values,
+    gsize n_values,
+    guint16 *min,
+    guint16 *max)
+{
+  __m128i min_v = _mm_set1_epi16 (*min);
+  __m128i max_v = _mm_set1_epi16 (*max);
+  gsize i;
+
+  for (i = 0; n_values - i >= 8; i += 8)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (values + i));
+
+      min_v = _mm_min_epu16 (min_v, v);
+      max_v = _mm_max_epu16 (max_v, v);
+    }
+
+  /* minpos finds the minimum of the 8 lanes, the maximum is the minimum of
+   * the complement */
+  *min = _mm_extract_epi16 (_mm_minpos_epu16 (min_v), 0);
+  *max = (guint16) ~_mm_extract_epi16 (
+      _mm_minpos_epu16 (_mm_xor_si128 (max_v, _mm_set1_epi16 (-1))), 0);
+
+  min_max_scalar (values + i, n_values - i, min, max);
+}
+
+__attribute__ ((target ("sse4.2")))
+static void
+interleave_sse42 (const guint16 *first,
+    const guint16 *second,
+    gsize n_values,
+    guint16 *dest)
+{
+  gsize i;
+
+  for (i = 0; n_values - i >= 8; i += 8)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (first + i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (second + i));
+
+      _mm_storeu_si128 ((__m128i *) (dest + 2 * i),
+          _mm_unpacklo_epi16 (a, b));
+      _mm_storeu_si128 ((__m128i *) (dest + 2 * i + 8),
+          _mm_unpackhi_epi16 (a, b));
+    }
+
+  interleave_scalar (first + i, second + i, n_values - i, dest + 2 * i);
+}
+
+static const Kernels sse42_kernels = {
+  "sse4.2",
+  min_max_sse42,
+  interleave_sse42,
+};
+
+/* AVX2 kernels, 16 values per vector */
+
+__attribute__ ((target ("avx2")))
+static void
+min_max_avx2 (const guint16 *values,
+    gsize n_values,
+    guint16 *min,
+    guint16 *max)
+{
+  __m256i min_v = _mm256_set1_epi16 (*min);
+  __m256i max_v = _mm256_set1_epi16 (*max);
+  __m128i min_h, max_h;
+  gsize i;
+
+  for (i = 0; n_values - i >= 16; i += 16)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (values + i));
+
+      min_v = _mm256_min_epu16 (min_v, v);
+      max_v = _mm256_max_epu16 (max_v, v);
+    }
+
+  min_h = _mm_min_epu16 (_mm256_castsi256_si128 (min_v),
+      _mm256_extracti128_si256 (min_v, 1));
+  max_h = _mm_max_epu16 (_mm256_castsi256_si128 (max_v),
+      _mm256_extracti128_si256 (max_v, 1));
+  *min = _mm_extract_epi16 (_mm_minpos_epu16 (min_h), 0);
+  *max = (guint16) ~_mm_extract_epi16 (
+      _mm_minpos_epu16 (_mm_xor_si128 (max_h, _mm_set1_epi16 (-1))), 0);
+
+  min_max_scalar (values + i, n_values - i, min, max);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+interleave_avx2 (const guint16 *first,
+    const guint16 *second,
+    gsize n_values,
+    guint16 *dest)
+{
+  gsize i;
+
+  for (i = 0; n_values - i >= 16; i += 16)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) (first + i));
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) (second + i));
+      /* Unpacking works within 128-bit lanes: lo has pairs 0-3 and 8-11, hi
+       * pairs 4-7 and 12-15 */
+      __m256i lo = _mm256_unpacklo_epi16 (a, b);
+      __m256i hi = _mm256_unpackhi_epi16 (a, b);
+
+      _mm256_storeu_si256 ((__m256i *) (dest + 2 * i),
+          _mm256_permute2x128_si256 (lo, hi, 0x20));
+      _mm256_storeu_si256 ((__m256i *) (dest + 2 * i + 16),
+          _mm256_permute2x128_si256 (lo, hi, 0x31));
+    }
+
+  interleave_scalar (first + i, second + i, n_values - i, dest + 2 * i);
+}
+
+static const Kernels avx2_kernels = {
+  "avx2",
+  min_max_avx2,
+  interleave_avx2,
+};
+
+#endif /* HAVE_X86_KERNELS */
+
+static const Kernels *
+get_kernels (void)
+{
+  static const Kernels *kernels = NULL;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      const gchar *name = g_getenv ("OPENGLUCOSE_KERNELS");
+
+      kernels = &scalar_kernels;
+
+#ifdef HAVE_X86_KERNELS
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2") &&
+          (name == NULL || g_str_equal (name, "avx2")))
+        kernels = &avx2_kernels;
+      else if (__builtin_cpu_supports ("sse4.2") &&
+          (name == NULL || !g_str_equal (name, "scalar")))
+        kernels = &sse42_kernels;
+#endif
+
+      if (name != NULL && !g_str_equal (name, kernels->name))
+        g_warning ("Kernels '%s' not supported, using '%s'",
+            name, kernels->name);
+
+      DEBUG ("Using %s kernels", kernels->name);
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return kernels;
+}
+
+const gchar *
+og_kernels_get_name (void)
+{
+  return get_kernels ()->name;
+}
+
+/* *min and *max must be initialized, e.g. to G_MAXUINT16 and 0 */
+void
+og_kernels_min_max (const guint16 *values,
+    gsize n_values,
+    guint16 *min,
+    guint16 *max)
+{
+  g_return_if_fail (values != NULL || n_values == 0);
+  g_return_if_fail (min != NULL && max != NULL);
+
+  get_kernels ()->min_max (values, n_values, min, max);
+}
+
+/* Copy @first and @second into @dest, which has room for 2 * @n_values, as
+ * pairs: first[0], second[0], first[1], second[1]... */
+void
+og_kernels_interleave (const guint16 *first,
+    const guint16 *second,
+    gsize n_values,
+    guint16 *dest)
+{
+  g_return_if_fail (first != NULL || n_values == 0);
+  g_return_if_fail (second != NULL || n_values == 0);
+  g_return_if_fail (dest != NULL || n_values == 0);
+
+  get_kernels ()->interleave (first, second, n_values, dest);
+}
+
+/* Sum and count values in buckets of @key_width wide ranges of their key.
+ * Keys must be below @n_buckets * @key_width. It is scalar only: the modal day
+ * has a bucket per minute, too many for masked passes per bucket to pay
+ * off, and x86 has no scatter before AVX-512. */
+void
+og_kernels_bucket_sums (const guint16 *values,
+    const guint16 *keys,
+    gsize n_values,
+    guint key_width,
+    guint n_buckets,
+    guint64 *sums,
+    guint *counts)
+{
+  gsize i;
+
+  g_return_if_fail (values != NULL || n_values == 0);
+  g_return_if_fail (keys != NULL || n_values == 0);
+  g_return_if_fail (key_width > 0);
+  g_return_if_fail (sums != NULL && counts != NULL);
+
+  for (i = 0; i < n_values; i++)
+    {
+      guint bucket = keys[i] / key_width;
+
+      sums[bucket] += values[i];
+      counts[bucket]++;
+    }
+}
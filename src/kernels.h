@@ -0,0 +1,38 @@
+#ifndef __OG_KERNELS_H__
+#define __OG_KERNELS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Kernels over packed arrays of readings. Min/max and interleaving are
+ * vectorized with SSE4.2 or AVX2 when the CPU supports it. The implementation
+ * is picked on first use and can be forced by setting OPENGLUCOSE_KERNELS to
+ * "scalar", "sse4.2" or "avx2".
+ *
+ * Min/max and bucket sums accumulate into their output arguments, so they can
+ * be run on several arrays in a row. */
+
+const gchar *og_kernels_get_name (void);
+
+void og_kernels_min_max (const guint16 *values,
+    gsize n_values,
+    guint16 *min,
+    guint16 *max);
+
+void og_kernels_interleave (const guint16 *first,
+    const guint16 *second,
+    gsize n_values,
+    guint16 *dest);
+
+void og_kernels_bucket_sums (const guint16 *values,
+    const guint16 *keys,
+    gsize n_values,
+    guint key_width,
+    guint n_buckets,
+    guint64 *sums,
+    guint *counts);
+
+G_END_DECLS
+
+#endif /* __OG_KERNELS_H__ */
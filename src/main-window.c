@@ -138,3 +138,37 @@ og_main_window_remove_device (OgMainWindow *self,
 
   g_hash_table_remove (self->priv->devices, device);
 }
+
+void
+og_main_window_dump_memory_usage (OgMainWindow *self)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_return_if_fail (OG_IS_MAIN_WINDOW (self));
+
+  g_hash_table_iter_init (&iter, self->priv->devices);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      OgBaseDevice *device = key;
+      OgMemoryUsage *usage;
+      const gchar *serial_number;
+      gchar *str;
+
+      usage = og_memory_usage_new ();
+      og_base_device_account_memory (device, usage);
+      og_device_widget_account_memory (value, usage);
+
+      /* Not known until the device is prepared */
+      serial_number = og_base_device_get_serial_number (device);
+
+      str = og_memory_usage_to_string (usage);
+      g_print ("Memory usage of %s (%s):\n%s",
+          og_base_device_get_name (device),
+          serial_number != NULL ? serial_number : "-",
+          str);
+
+      g_free (str);
+      og_memory_usage_free (usage);
+    }
+}
@@ -44,6 +44,7 @@ void og_main_window_add_device (OgMainWindow *self,
     OgBaseDevice *device);
 void og_main_window_remove_device (OgMainWindow *self,
     OgBaseDevice *device);
+void og_main_window_dump_memory_usage (OgMainWindow *self);
 
 G_END_DECLS
 
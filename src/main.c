@@ -1,12 +1,19 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <signal.h>
+#include <glib-unix.h>
 #include <gusb.h>
 
 #include "base-device.h"
+#ifdef ENABLE_WEBKIT
+#include "chart-snapshots.h"
+#include "chart-view-pool.h"
+#endif
 #include "dummy-device.h"
 #include "insulinx.h"
 #include "main-window.h"
+#include "trace.h"
 
 typedef struct
 {
@@ -28,6 +35,7 @@ typedef struct
   /* Owned GUsbDevice -> owned OgBaseDevice */
   GHashTable *devices_table;
   GUsbContext *context;
+  guint sigusr1_id;
 } OgApplication;
 
 typedef struct
@@ -60,6 +68,8 @@ add_device (OgApplication *self,
               g_object_ref (device),
               base);
           og_main_window_add_device ((OgMainWindow *) self->window, base);
+          og_trace_counter ("devices",
+              g_hash_table_size (self->devices_table));
           break;
         }
     }
@@ -76,9 +86,21 @@ remove_device (OgApplication *self,
     {
       og_main_window_remove_device ((OgMainWindow *) self->window, base);
       g_hash_table_remove (self->devices_table, device);
+      og_trace_counter ("devices",
+          g_hash_table_size (self->devices_table));
     }
 }
 
+static gboolean
+sigusr1_cb (gpointer user_data)
+{
+  OgApplication *self = user_data;
+
+  og_main_window_dump_memory_usage ((OgMainWindow *) self->window);
+
+  return G_SOURCE_CONTINUE;
+}
+
 static void
 startup (GApplication *app)
 {
@@ -88,18 +110,28 @@ startup (GApplication *app)
   guint i;
   GError *error = NULL;
 
+  og_trace_mark ("startup()");
+  og_trace_begin ("startup");
+
   G_APPLICATION_CLASS (og_application_parent_class)->startup (app);
 
   provider = gtk_css_provider_new ();
   gtk_css_provider_load_from_resource (provider,
       "/org/freedesktop/OpenGlucose/src/openglucose.css");
+  og_trace_mark ("CSS loaded");
   gtk_style_context_add_provider_for_screen (gdk_screen_get_default (),
       GTK_STYLE_PROVIDER (provider),
       GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
   g_object_unref (provider);
 
+#ifdef ENABLE_WEBKIT
+  og_chart_view_pool_init ();
+  og_trace_mark ("Chart views prewarming");
+#endif
+
   self->window = og_main_window_new ((GtkApplication *) self);
   gtk_widget_show (self->window);
+  og_trace_mark ("Window shown");
 
   self->devices_table = g_hash_table_new_full (g_direct_hash, g_direct_equal,
       g_object_unref, g_object_unref);
@@ -108,17 +140,23 @@ startup (GApplication *app)
   if (self->context == NULL)
     g_error ("Error creating USB context: %s", error->message);
 
+  og_trace_begin ("usb-enumerate");
   g_usb_context_enumerate (self->context);
   devices = g_usb_context_get_devices (self->context);
   for (i = 0; i < devices->len; i++)
     add_device (self, g_ptr_array_index (devices, i));
   g_ptr_array_unref (devices);
+  og_trace_end ("usb-enumerate");
+  og_trace_mark ("USB enumerated");
 
   g_signal_connect_swapped (self->context, "device-added",
       G_CALLBACK (add_device), self);
   g_signal_connect_swapped (self->context, "device-removed",
       G_CALLBACK (remove_device), self);
 
+  /* Dump per-device memory usage on "kill -USR1" */
+  self->sigusr1_id = g_unix_signal_add (SIGUSR1, sigusr1_cb, self);
+
   if (g_getenv ("OPENGLUCOSE_DUMMY_DEVICE") != NULL)
     {
       OgBaseDevice *base;
@@ -127,6 +165,8 @@ startup (GApplication *app)
       og_main_window_add_device ((OgMainWindow *) self->window, base);
       g_object_unref (base);
     }
+
+  og_trace_end ("startup");
 }
 
 static void
@@ -134,8 +174,13 @@ shutdown (GApplication *app)
 {
   OgApplication *self = (OgApplication *) app;
 
+  g_source_remove (self->sigusr1_id);
   g_hash_table_unref (self->devices_table);
   g_object_unref (self->context);
+#ifdef ENABLE_WEBKIT
+  og_chart_view_pool_shutdown ();
+  og_chart_snapshots_shutdown ();
+#endif
 
   G_APPLICATION_CLASS (og_application_parent_class)->shutdown (app);
 }
@@ -169,6 +214,23 @@ int
 main (int argc, char *argv[])
 {
   GApplication *app;
+  gboolean profile_startup = FALSE;
+  gint i, j;
+
+  /* g_application_add_main_option() needs GLib 2.42, strip our own option
+   * before handing argv over to GApplication. */
+  for (i = 1, j = 1; i < argc; i++)
+    {
+      if (g_str_equal (argv[i], "--profile-startup"))
+        profile_startup = TRUE;
+      else
+        argv[j++] = argv[i];
+    }
+  argc = j;
+  argv[argc] = NULL;
+
+  og_trace_init (profile_startup);
+  og_trace_mark ("main()");
 
   app = g_object_new (OG_TYPE_APPLICATION,
       "application-id", "org.freedesktop.OpenGlucose",
@@ -179,5 +241,7 @@ main (int argc, char *argv[])
 
   g_object_unref (app);
 
+  og_trace_shutdown ();
+
   return EXIT_SUCCESS;
 }
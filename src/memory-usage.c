@@ -0,0 +1,91 @@
+#include "config.h"
+
+#include "memory-usage.h"
+
+OgMemoryUsage *
+og_memory_usage_new (void)
+{
+  OgMemoryUsage *self;
+
+  self = g_slice_new0 (OgMemoryUsage);
+  self->entries = g_array_new (FALSE, FALSE, sizeof (OgMemoryUsageEntry));
+
+  return self;
+}
+
+void
+og_memory_usage_free (OgMemoryUsage *self)
+{
+  if (self == NULL)
+    return;
+
+  g_array_unref (self->entries);
+  g_slice_free (OgMemoryUsage, self);
+}
+
+/* @subsystem must be a static string, bytes accounted multiple times for the
+ * same subsystem are summed. */
+void
+og_memory_usage_add (OgMemoryUsage *self,
+    const gchar *subsystem,
+    gsize n_bytes)
+{
+  OgMemoryUsageEntry entry;
+  guint i;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (subsystem != NULL);
+
+  for (i = 0; i < self->entries->len; i++)
+    {
+      OgMemoryUsageEntry *e;
+
+      e = &g_array_index (self->entries, OgMemoryUsageEntry, i);
+      if (g_str_equal (e->subsystem, subsystem))
+        {
+          e->n_bytes += n_bytes;
+          return;
+        }
+    }
+
+  entry.subsystem = subsystem;
+  entry.n_bytes = n_bytes;
+  g_array_append_val (self->entries, entry);
+}
+
+gsize
+og_memory_usage_get_total (OgMemoryUsage *self)
+{
+  gsize total = 0;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  for (i = 0; i < self->entries->len; i++)
+    total += g_array_index (self->entries, OgMemoryUsageEntry, i).n_bytes;
+
+  return total;
+}
+
+gchar *
+og_memory_usage_to_string (OgMemoryUsage *self)
+{
+  GString *string;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  string = g_string_new (NULL);
+  for (i = 0; i < self->entries->len; i++)
+    {
+      OgMemoryUsageEntry *e;
+
+      e = &g_array_index (self->entries, OgMemoryUsageEntry, i);
+      g_string_append_printf (string, "  %-24s %10" G_GSIZE_FORMAT "\n",
+          e->subsystem, e->n_bytes);
+    }
+  g_string_append_printf (string, "  %-24s %10" G_GSIZE_FORMAT "\n",
+      "total", og_memory_usage_get_total (self));
+
+  return g_string_free (string, FALSE);
+}
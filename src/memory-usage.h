@@ -0,0 +1,35 @@
+#ifndef __OG_MEMORY_USAGE_H__
+#define __OG_MEMORY_USAGE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* GDateTime is opaque, that is the size of its slice in GLib 2.40 */
+#define OG_DATE_TIME_SIZE \
+    (sizeof (gint64) + sizeof (gpointer) + 3 * sizeof (gint32))
+
+typedef struct
+{
+  const gchar *subsystem;
+  gsize n_bytes;
+} OgMemoryUsageEntry;
+
+typedef struct
+{
+  /* GArray<OgMemoryUsageEntry> */
+  GArray *entries;
+} OgMemoryUsage;
+
+OgMemoryUsage *og_memory_usage_new (void);
+void og_memory_usage_free (OgMemoryUsage *self);
+
+void og_memory_usage_add (OgMemoryUsage *self,
+    const gchar *subsystem,
+    gsize n_bytes);
+gsize og_memory_usage_get_total (OgMemoryUsage *self);
+gchar *og_memory_usage_to_string (OgMemoryUsage *self);
+
+G_END_DECLS
+
+#endif /* __OG_MEMORY_USAGE_H__ */
@@ -0,0 +1,392 @@
+#include "config.h"
+
+#include "modal-day-chart.h"
+
+#include <math.h>
+#include <glib/gi18n.h>
+
+#include "chart-drawing.h"
+#include "kernels.h"
+
+G_DEFINE_TYPE (OgModalDayChart, og_modal_day_chart, GTK_TYPE_DRAWING_AREA)
+
+/* Space around the plot area for the title and axis labels, in pixels */
+#define MARGIN_TOP 30
+#define MARGIN_BOTTOM 30
+#define MARGIN_LEFT 50
+#define MARGIN_RIGHT 20
+
+/* The glycemia axis goes up to a multiple of that, in mg/dl */
+#define VALUE_STEP 50
+
+/* Side of the scatter markers, in pixels */
+#define MARKER_SIZE 3
+
+struct _OgModalDayChartPrivate
+{
+  /* Owned, NULL until set */
+  OgChartData *data;
+  /* GArray<OgChartPoint> */
+  GArray *mean;
+  guint max_value;
+  /* Drawn instead of the readings when there are too many of them, one pixel
+   * per bin with the lowest glycemia at the bottom, NULL otherwise */
+  cairo_surface_t *density;
+
+  guint hypoglycemia;
+  guint hyperglycemia;
+};
+
+/* Same styles as modal-day-chart.js */
+static const struct
+{
+  gdouble width;
+  gboolean dashed;
+  gdouble gray;
+  gdouble alpha;
+} agp_styles[OG_AGP_N_PERCENTILES] = {
+  { 1, TRUE, 0.31, 0.8 },   /* 5% */
+  { 1.5, FALSE, 0.31, 0.8 }, /* 25% */
+  { 2.5, FALSE, 0, 0.9 },   /* 50% */
+  { 1.5, FALSE, 0.31, 0.8 }, /* 75% */
+  { 1, TRUE, 0.31, 0.8 },   /* 95% */
+};
+
+static void
+draw_axes (OgModalDayChart *self,
+    cairo_t *cr,
+    const OgChartArea *area)
+{
+  GtkWidget *widget = (GtkWidget *) self;
+  GdkRGBA color;
+  guint value_step;
+  guint hour;
+  guint value;
+
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+      gtk_widget_get_state_flags (widget), &color);
+
+  value_step = area->max_value > 8 * VALUE_STEP ? 2 * VALUE_STEP : VALUE_STEP;
+
+  /* Grid */
+  cairo_set_line_width (cr, 1);
+  cairo_set_source_rgba (cr, color.red, color.green, color.blue, 0.15);
+  for (hour = 0; hour <= 24; hour += 2)
+    {
+      gdouble x = (gint) og_chart_area_get_x (area, hour * 3600) + 0.5;
+
+      cairo_move_to (cr, x, area->y);
+      cairo_line_to (cr, x, area->y + area->height);
+    }
+  for (value = 0; value <= area->max_value; value += value_step)
+    {
+      gdouble y = (gint) og_chart_area_get_y (area, value) + 0.5;
+
+      cairo_move_to (cr, area->x, y);
+      cairo_line_to (cr, area->x + area->width, y);
+    }
+  cairo_stroke (cr);
+
+  /* Labels */
+  gdk_cairo_set_source_rgba (cr, &color);
+  for (hour = 0; hour <= 24; hour += 2)
+    {
+      gchar *text = g_strdup_printf ("%02u:00", hour);
+
+      og_chart_draw_text (widget, cr, text,
+          og_chart_area_get_x (area, hour * 3600),
+          area->y + area->height + 4, 0.5, 0);
+      g_free (text);
+    }
+  for (value = 0; value <= area->max_value; value += value_step)
+    {
+      gchar *text = g_strdup_printf ("%u", value);
+
+      og_chart_draw_text (widget, cr, text, area->x - 6,
+          og_chart_area_get_y (area, value), 1, 0.5);
+      g_free (text);
+    }
+
+  og_chart_draw_text (widget, cr, _("Modal Day Report"),
+      area->x + area->width / 2, MARGIN_TOP / 2, 0.5, 0.5);
+}
+
+static void
+draw_series (cairo_t *cr,
+    const OgChartArea *area,
+    const OgChartPoint *points,
+    guint n_points)
+{
+  guint i;
+
+  for (i = 0; i < n_points; i++)
+    {
+      gdouble x = og_chart_area_get_x (area, points[i].seconds);
+      gdouble y = og_chart_area_get_y (area, points[i].value);
+
+      if (i == 0)
+        cairo_move_to (cr, x, y);
+      else
+        cairo_line_to (cr, x, y);
+    }
+  cairo_stroke (cr);
+}
+
+static void
+draw_agp (cairo_t *cr,
+    const OgChartArea *area,
+    const OgAgp *agp)
+{
+  static const gdouble dashes[] = { 4, 4 };
+  OgChartPoint points[OG_AGP_N_BINS];
+  guint n_points;
+  guint i, j;
+
+  for (j = 0; j < OG_AGP_N_PERCENTILES; j++)
+    {
+      n_points = 0;
+      for (i = 0; i < OG_AGP_N_BINS; i++)
+        {
+          if (agp->n_values[i] == 0)
+            continue;
+
+          points[n_points].seconds = (i * 15 + 7) * 60 + 30;
+          points[n_points].value = (guint) (agp->percentiles[i][j] + 0.5);
+          n_points++;
+        }
+
+      cairo_set_line_width (cr, agp_styles[j].width);
+      cairo_set_dash (cr, dashes, agp_styles[j].dashed ? 2 : 0, 0);
+      cairo_set_source_rgba (cr, agp_styles[j].gray, agp_styles[j].gray,
+          agp_styles[j].gray, agp_styles[j].alpha);
+      draw_series (cr, area, points, n_points);
+    }
+  cairo_set_dash (cr, NULL, 0, 0);
+}
+
+/* Same colors as modal-day-chart.js, the denser the more opaque */
+static cairo_surface_t *
+create_density_surface (const OgDensity *density)
+{
+  cairo_surface_t *surface;
+  guchar *data;
+  gint stride;
+  guint row, column;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+      OG_DENSITY_COLUMNS, OG_DENSITY_ROWS);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  for (row = 0; row < OG_DENSITY_ROWS; row++)
+    {
+      guint32 *pixels;
+
+      pixels = (guint32 *) (data + (OG_DENSITY_ROWS - 1 - row) * stride);
+      for (column = 0; column < OG_DENSITY_COLUMNS; column++)
+        {
+          guint32 count = density->counts[row][column];
+          guint alpha = 0;
+
+          if (count > 0)
+            alpha = MAX (40, (guint) (255 *
+                    sqrt ((gdouble) count / density->max_count)));
+
+          /* Premultiplied */
+          pixels[column] = alpha << 24 |
+              (75 * alpha / 255) << 16 |
+              (178 * alpha / 255) << 8 |
+              (197 * alpha / 255);
+        }
+    }
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static void
+draw_density (cairo_t *cr,
+    const OgChartArea *area,
+    cairo_surface_t *density)
+{
+  gdouble row_height;
+
+  /* Scaled as a single image, up to OG_GLYCEMIA_MAX */
+  row_height = area->height * OG_DENSITY_GLYCEMIA / area->max_value;
+
+  cairo_save (cr);
+  cairo_rectangle (cr, area->x, area->y, area->width, area->height);
+  cairo_clip (cr);
+  cairo_translate (cr, area->x,
+      area->y + area->height - row_height * OG_DENSITY_ROWS);
+  cairo_scale (cr, area->width / OG_DENSITY_COLUMNS, row_height);
+  cairo_set_source_surface (cr, density, 0, 0);
+  cairo_paint (cr);
+  cairo_restore (cr);
+}
+
+static gboolean
+draw (GtkWidget *widget,
+    cairo_t *cr)
+{
+  OgModalDayChart *self = (OgModalDayChart *) widget;
+  const guint16 *glycemia;
+  const guint16 *minutes;
+  guint n_readings;
+  OgChartArea area;
+  guint i;
+
+  area.x = MARGIN_LEFT;
+  area.y = MARGIN_TOP;
+  area.width = gtk_widget_get_allocated_width (widget) -
+      MARGIN_LEFT - MARGIN_RIGHT;
+  area.height = gtk_widget_get_allocated_height (widget) -
+      MARGIN_TOP - MARGIN_BOTTOM;
+  if (self->priv->data == NULL || area.width <= 0 || area.height <= 0)
+    return FALSE;
+  area.start = 0;
+  area.end = OG_SECONDS_PER_DAY;
+
+  /* Thresholds bands are always fully visible */
+  area.max_value = MAX (self->priv->max_value, self->priv->hyperglycemia) +
+      VALUE_STEP;
+  area.max_value -= area.max_value % VALUE_STEP;
+
+  og_chart_draw_threshold_bands (cr, &area, self->priv->hypoglycemia,
+      self->priv->hyperglycemia);
+  draw_axes (self, cr, &area);
+
+  if (self->priv->density != NULL)
+    {
+      draw_density (cr, &area, self->priv->density);
+    }
+  else
+    {
+      /* Readings, all in a single path */
+      glycemia = og_chart_data_get_readings (self->priv->data, &minutes,
+          &n_readings);
+      cairo_set_source_rgba (cr, 0.29, 0.70, 0.77, 0.8);
+      for (i = 0; i < n_readings; i++)
+        cairo_rectangle (cr,
+            og_chart_area_get_x (&area, minutes[i] * 60) - MARKER_SIZE / 2.0,
+            og_chart_area_get_y (&area, glycemia[i]) - MARKER_SIZE / 2.0,
+            MARKER_SIZE, MARKER_SIZE);
+      cairo_fill (cr);
+    }
+
+  draw_agp (cr, &area, og_chart_data_get_agp (self->priv->data));
+
+  cairo_set_line_width (cr, 2);
+  cairo_set_source_rgb (cr, 0.92, 0.64, 0.16);
+  draw_series (cr, &area, (const OgChartPoint *) self->priv->mean->data,
+      self->priv->mean->len);
+
+  return FALSE;
+}
+
+static void
+og_modal_day_chart_init (OgModalDayChart *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      OG_TYPE_MODAL_DAY_CHART, OgModalDayChartPrivate);
+}
+
+static void
+finalize (GObject *object)
+{
+  OgModalDayChart *self = (OgModalDayChart *) object;
+
+  og_chart_data_free (self->priv->data);
+  g_clear_pointer (&self->priv->mean, g_array_unref);
+  g_clear_pointer (&self->priv->density, cairo_surface_destroy);
+
+  G_OBJECT_CLASS (og_modal_day_chart_parent_class)->finalize (object);
+}
+
+static void
+og_modal_day_chart_class_init (OgModalDayChartClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->finalize = finalize;
+  widget_class->draw = draw;
+
+  g_type_class_add_private (object_class, sizeof (OgModalDayChartPrivate));
+}
+
+GtkWidget *
+og_modal_day_chart_new (void)
+{
+  return g_object_new (OG_TYPE_MODAL_DAY_CHART, NULL);
+}
+
+/* Takes ownership of @data, built with OG_CHART_DATA_MODAL_DAY */
+void
+og_modal_day_chart_set_data (OgModalDayChart *self,
+    OgChartData *data)
+{
+  const guint16 *glycemia;
+  guint n_readings;
+  guint16 min = G_MAXUINT16;
+  guint16 max = 0;
+  OgDensity *density;
+
+  g_return_if_fail (OG_IS_MODAL_DAY_CHART (self));
+  g_return_if_fail (og_chart_data_get_flags (data) & OG_CHART_DATA_MODAL_DAY);
+
+  og_chart_data_free (self->priv->data);
+  g_clear_pointer (&self->priv->mean, g_array_unref);
+  g_clear_pointer (&self->priv->density, cairo_surface_destroy);
+
+  self->priv->data = data;
+  self->priv->mean = og_chart_data_dup_mean (data);
+  self->priv->hypoglycemia = og_chart_data_get_hypoglycemia (data);
+  self->priv->hyperglycemia = og_chart_data_get_hyperglycemia (data);
+
+  glycemia = og_chart_data_get_readings (data, NULL, &n_readings);
+  og_kernels_min_max (glycemia, n_readings, &min, &max);
+  self->priv->max_value = max;
+
+  /* Drawing cost then depends on the number of bins only */
+  density = g_new (OgDensity, 1);
+  if (og_chart_data_compute_density (data, density))
+    self->priv->density = create_density_surface (density);
+  g_free (density);
+
+  gtk_widget_queue_draw ((GtkWidget *) self);
+}
+
+/* Accepts NULL, before the chart is created */
+gsize
+og_modal_day_chart_get_size (OgModalDayChart *self)
+{
+  gsize size;
+
+  if (self == NULL)
+    return 0;
+
+  size = sizeof (OgModalDayChartPrivate);
+  if (self->priv->data != NULL)
+    size += og_chart_data_get_size (self->priv->data);
+  if (self->priv->mean != NULL)
+    size += self->priv->mean->len * sizeof (OgChartPoint);
+  if (self->priv->density != NULL)
+    size += OG_DENSITY_ROWS * cairo_image_surface_get_stride (
+        self->priv->density);
+
+  return size;
+}
+
+void
+og_modal_day_chart_set_thresholds (OgModalDayChart *self,
+    guint hypoglycemia,
+    guint hyperglycemia)
+{
+  g_return_if_fail (OG_IS_MODAL_DAY_CHART (self));
+
+  self->priv->hypoglycemia = hypoglycemia;
+  self->priv->hyperglycemia = hyperglycemia;
+
+  gtk_widget_queue_draw ((GtkWidget *) self);
+}
@@ -0,0 +1,53 @@
+#ifndef __OG_MODAL_DAY_CHART_H__
+#define __OG_MODAL_DAY_CHART_H__
+
+#include <gtk/gtk.h>
+
+#include "chart-data.h"
+
+G_BEGIN_DECLS
+
+#define OG_TYPE_MODAL_DAY_CHART \
+    (og_modal_day_chart_get_type ())
+#define OG_MODAL_DAY_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST ((obj), OG_TYPE_MODAL_DAY_CHART, \
+        OgModalDayChart))
+#define OG_MODAL_DAY_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST ((klass), OG_TYPE_MODAL_DAY_CHART, \
+        OgModalDayChartClass))
+#define OG_IS_MODAL_DAY_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE ((obj), OG_TYPE_MODAL_DAY_CHART))
+#define OG_IS_MODAL_DAY_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE ((klass), OG_TYPE_MODAL_DAY_CHART))
+#define OG_MODAL_DAY_CHART_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS ((obj), OG_TYPE_MODAL_DAY_CHART, \
+        OgModalDayChartClass))
+
+typedef struct _OgModalDayChart OgModalDayChart;
+typedef struct _OgModalDayChartClass OgModalDayChartClass;
+typedef struct _OgModalDayChartPrivate OgModalDayChartPrivate;
+
+struct _OgModalDayChart {
+  GtkDrawingArea parent;
+
+  OgModalDayChartPrivate *priv;
+};
+
+struct _OgModalDayChartClass {
+  GtkDrawingAreaClass parent_class;
+};
+
+GType og_modal_day_chart_get_type (void) G_GNUC_CONST;
+
+GtkWidget *og_modal_day_chart_new (void);
+
+void og_modal_day_chart_set_data (OgModalDayChart *self,
+    OgChartData *data);
+void og_modal_day_chart_set_thresholds (OgModalDayChart *self,
+    guint hypoglycemia,
+    guint hyperglycemia);
+gsize og_modal_day_chart_get_size (OgModalDayChart *self);
+
+G_END_DECLS
+
+#endif /* __OG_MODAL_DAY_CHART_H__ */
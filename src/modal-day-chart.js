@@ -1,11 +1,50 @@
 var plot;
+var thresholds;
+var serial = 0;
 
-function OgChartPlot(title, hypo, hyper, series)
+/* Time of the day in milliseconds, as the date axis expects */
+var midnight = new Date(0, 0, 0).getTime();
+var day = 24 * 60 * 60 * 1000;
+
+/* Readings are drawn on a canvas of their own below the series, that many per
+ * animation frame so the view stays responsive however many there are */
+var POINTS_PER_FRAME = 4000;
+var POINT_SIZE = 3;
+
+var requestFrame = window.requestAnimationFrame ||
+    window.webkitRequestAnimationFrame ||
+    function(callback) { return window.setTimeout(callback, 16); };
+
+/* Minutes and glycemia interleaved, as received so far */
+var readings = new Uint16Array(0);
+var n_received = 0;
+var n_drawn = 0;
+var canvas = null;
+var frame_pending = false;
+/* Data to report done with once all its readings are drawn */
+var done_uri = null;
+/* Above the density threshold, the density of readings as an image with a
+ * pixel per bin, drawn scaled instead of the readings */
+var density = null;
+var density_glycemia = 0;
+var density_drawn = false;
+
+/* The glycemia axis goes up to a multiple of 50 mg/dl, with the threshold
+ * bands always fully visible */
+function OgChartAxisMax(max_glycemia, hyper)
+{
+  var max = Math.max(max_glycemia, hyper) + 50;
+
+  return max - max % 50;
+}
+
+function OgChartPlot(title, hypo, hyper, series, max)
 {
   var overlay = {
     show: true,
     objects: [{
       rectangle: {
+        name: "hypo",
         ymin: 0,
         ymax: hypo,
         xminOffset: "0px",
@@ -19,6 +58,7 @@ function OgChartPlot(title, hypo, hyper, series)
     },
     {
       rectangle: {
+        name: "good",
         ymin: hypo,
         ymax: hyper,
         xminOffset: "0px",
@@ -32,6 +72,7 @@ function OgChartPlot(title, hypo, hyper, series)
     },
     {
       rectangle: {
+        name: "hyper",
         ymin: hyper,
         xminOffset: "0px",
         xmaxOffset: "0px",
@@ -48,15 +89,37 @@ function OgChartPlot(title, hypo, hyper, series)
     title: title,
     series: [{
       renderer: $.jqplot.LineRenderer,
-      showLine: false,
-      pointLabels: {show: false},
+      lineWidth: 2,
+      color: "#eaa228",
       markerOptions: {size: 5}
     },
+    /* AGP percentiles: 5%, 25%, 50%, 75% and 95% */
     {
-      renderer: $.jqplot.LineRenderer,
-      lineWidth: 2,
-      pointLabels: {show: false},
-      markerOptions: {size: 5}
+      lineWidth: 1,
+      linePattern: 'dashed',
+      color: "rgba(80, 80, 80, 0.8)",
+      showMarker: false
+    },
+    {
+      lineWidth: 1.5,
+      color: "rgba(80, 80, 80, 0.8)",
+      showMarker: false
+    },
+    {
+      lineWidth: 2.5,
+      color: "rgba(0, 0, 0, 0.9)",
+      showMarker: false
+    },
+    {
+      lineWidth: 1.5,
+      color: "rgba(80, 80, 80, 0.8)",
+      showMarker: false
+    },
+    {
+      lineWidth: 1,
+      linePattern: 'dashed',
+      color: "rgba(80, 80, 80, 0.8)",
+      showMarker: false
     }],
     axesDefaults: {
       tickRenderer: $.jqplot.CanvasAxisTickRenderer,
@@ -68,12 +131,14 @@ function OgChartPlot(title, hypo, hyper, series)
           angle: 30,
           formatString: '%H:%M',
         },
-        autoscale: true,
+        min: midnight,
+        max: midnight + day,
+        tickInterval: '2 hours',
       },
       yaxis: {
         min: 0,
+        max: max,
         tickOptions: {angle: 30},
-        autoscale: true,
       },
     },
     canvasOverlay: overlay,
@@ -84,7 +149,285 @@ function OgChartPlot(title, hypo, hyper, series)
   });
 }
 
-function OgChartRePlot(series)
+function OgChartRePlot(series, max)
+{
+  plot.replot({resetAxis: true, data: series, axes: {yaxis: {max: max}}});
+}
+
+/* Tells the application we are done with the data at @uri, whatever
+ * happened to it */
+function OgChartDone(uri)
+{
+  var request = new XMLHttpRequest();
+
+  request.open("GET", uri.replace("/data/", "/done/"), true);
+  request.send();
+}
+
+function OgChartDrawReadings()
+{
+  var context = canvas.getContext("2d");
+  var xaxis = plot.axes.xaxis;
+  var yaxis = plot.axes.yaxis;
+  var end = Math.min(n_received, n_drawn + POINTS_PER_FRAME);
+  var i;
+
+  frame_pending = false;
+
+  if (density !== null && !density_drawn)
+    {
+      var top = yaxis.series_u2p(density.height * density_glycemia);
+      var left = xaxis.series_u2p(midnight);
+
+      context.drawImage(density, left, top,
+          xaxis.series_u2p(midnight + day) - left,
+          yaxis.series_u2p(0) - top);
+      density_drawn = true;
+    }
+
+  context.fillStyle = "rgba(75, 178, 197, 0.8)";
+  for (i = n_drawn; i < end; i++)
+    context.fillRect(
+        xaxis.series_u2p(midnight + readings[2 * i] * 60000) - POINT_SIZE / 2,
+        yaxis.series_u2p(readings[2 * i + 1]) - POINT_SIZE / 2,
+        POINT_SIZE, POINT_SIZE);
+  n_drawn = end;
+
+  if (n_drawn < n_received)
+    {
+      OgChartScheduleDraw();
+    }
+  else if (done_uri !== null)
+    {
+      OgChartDone(done_uri);
+      done_uri = null;
+    }
+}
+
+function OgChartScheduleDraw()
+{
+  if (frame_pending || canvas === null)
+    return;
+
+  frame_pending = true;
+  requestFrame(OgChartDrawReadings);
+}
+
+/* Each (re)plot recreates the plot canvases, so readings are drawn again from
+ * the start on a canvas put back below the series */
+$.jqplot.postDrawHooks.push(function() {
+  var grid = this.grid;
+
+  if (canvas === null)
+    {
+      canvas = document.createElement("canvas");
+      canvas.style.position = "absolute";
+    }
+
+  canvas.width = grid._width;
+  canvas.height = grid._height;
+  canvas.style.left = grid._left + "px";
+  canvas.style.top = grid._top + "px";
+  $(this.series[0].shadowCanvas._elem).before(canvas);
+
+  n_drawn = 0;
+  density_drawn = false;
+  OgChartScheduleDraw();
+});
+
+/* Keep in sync with build_modal_day() in chart-data.c */
+function OgChartDecodeSummary(buffer, n_mean, n_agp)
+{
+  var offset = 9 * 4;
+  var mean = new Uint32Array(buffer, offset, n_mean * 2);
+  var agp = new Uint32Array(buffer, offset + mean.byteLength, n_agp * 6);
+  var series = [new Array(n_mean)];
+  var i, j;
+
+  for (i = 0; i < n_mean; i++)
+    series[0][i] = [midnight + mean[2 * i] * 1000, mean[2 * i + 1]];
+
+  /* One series per percentile */
+  for (j = 1; j < 6; j++)
+    {
+      var percentile = new Array(n_agp);
+
+      for (i = 0; i < n_agp; i++)
+        percentile[i] = [midnight + agp[6 * i] * 1000, agp[6 * i + j]];
+      series.push(percentile);
+    }
+
+  return series;
+}
+
+/* Calls @callback with the ArrayBuffer at @uri, or null on errors */
+function OgChartFetch(uri, callback)
+{
+  var request = new XMLHttpRequest();
+
+  request.open("GET", uri, true);
+  request.responseType = "arraybuffer";
+  request.onloadend = function() {
+    var buffer = request.response;
+
+    callback(buffer != null && buffer.byteLength > 0 ? buffer : null);
+  };
+  request.send();
+}
+
+/* Same colors as the readings, the denser the more opaque. Keep in sync with
+ * create_density_surface() in modal-day-chart.c */
+function OgChartDecodeDensity(buffer, columns, rows, max)
+{
+  var counts = new Uint32Array(buffer);
+  var image = document.createElement("canvas");
+  var context;
+  var pixels;
+  var row, column;
+
+  image.width = columns;
+  image.height = rows;
+  context = image.getContext("2d");
+  pixels = context.createImageData(columns, rows);
+
+  for (row = 0; row < rows; row++)
+    for (column = 0; column < columns; column++)
+      {
+        var count = counts[row * columns + column];
+        /* The lowest glycemia is at the bottom */
+        var i = ((rows - 1 - row) * columns + column) * 4;
+
+        pixels.data[i] = 75;
+        pixels.data[i + 1] = 178;
+        pixels.data[i + 2] = 197;
+        pixels.data[i + 3] = count > 0 ?
+            Math.max(40, Math.floor(255 * Math.sqrt(count / max))) : 0;
+      }
+  context.putImageData(pixels, 0, 0);
+
+  return image;
+}
+
+/* The density comes as a single chunk instead of batches of readings */
+function OgChartFetchDensity(uri, current, header)
+{
+  OgChartFetch(uri + "/1", function(buffer) {
+    if (current != serial)
+      return;
+
+    if (buffer !== null)
+      {
+        density = OgChartDecodeDensity(buffer, header[5], header[6],
+            header[8]);
+        density_glycemia = header[7];
+        density_drawn = false;
+      }
+
+    done_uri = uri;
+    OgChartScheduleDraw();
+  });
+}
+
+/* Batches are fetched one after the other, each drawn as it arrives */
+function OgChartFetchReadings(uri, current, batch, n_batches)
+{
+  if (batch > n_batches)
+    {
+      done_uri = uri;
+      OgChartScheduleDraw();
+      return;
+    }
+
+  OgChartFetch(uri + "/" + batch, function(buffer) {
+    if (current != serial)
+      return;
+
+    if (buffer === null)
+      {
+        OgChartDone(uri);
+        return;
+      }
+
+    readings.set(new Uint16Array(buffer), n_received * 2);
+    n_received += buffer.byteLength / 4;
+    OgChartScheduleDraw();
+
+    OgChartFetchReadings(uri, current, batch + 1, n_batches);
+  });
+}
+
+/* Fetches packed data published by the application: its first chunk has all
+ * that is needed to plot the chart, readings are then streamed in batches.
+ * Only the latest request is plotted, the first one with the given thresholds
+ * unless they have been set meanwhile. */
+function OgChartLoad(uri, title, hypo, hyper)
+{
+  var current = ++serial;
+
+  done_uri = null;
+
+  OgChartFetch(uri + "/0", function(buffer) {
+    var header;
+    var series;
+    var max;
+
+    if (current != serial)
+      return;
+
+    if (buffer === null)
+      {
+        OgChartDone(uri);
+        return;
+      }
+
+    header = new Uint32Array(buffer, 0, 9);
+    series = OgChartDecodeSummary(buffer, header[3], header[4]);
+
+    /* Replotting draws the received readings, so they go first */
+    readings = new Uint16Array(header[8] > 0 ? 0 : header[0] * 2);
+    n_received = 0;
+    density = null;
+
+    try
+      {
+        if (plot === undefined)
+          {
+            if (thresholds === undefined)
+              thresholds = [hypo, hyper];
+            max = OgChartAxisMax(header[2], thresholds[1]);
+            OgChartPlot(title, thresholds[0], thresholds[1], series, max);
+          }
+        else
+          {
+            OgChartRePlot(series, OgChartAxisMax(header[2], thresholds[1]));
+          }
+      }
+    catch (e)
+      {
+        OgChartDone(uri);
+        throw e;
+      }
+
+    if (header[8] > 0)
+      OgChartFetchDensity(uri, current, header);
+    else
+      OgChartFetchReadings(uri, current, 1, header[1]);
+  });
+}
+
+function OgChartSetThresholds(hypo, hyper)
 {
-  plot.replot({resetAxis: true, data: series});
+  var overlay;
+
+  thresholds = [hypo, hyper];
+  if (plot === undefined)
+    return;
+
+  overlay = plot.plugins.canvasOverlay;
+
+  overlay.get("hypo").options.ymax = hypo;
+  overlay.get("good").options.ymin = hypo;
+  overlay.get("good").options.ymax = hyper;
+  overlay.get("hyper").options.ymin = hyper;
+  overlay.draw(plot);
 }
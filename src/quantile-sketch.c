@@ -0,0 +1,57 @@
+#include "config.h"
+
+#include "quantile-sketch.h"
+
+void
+og_quantile_sketch_add (OgQuantileSketch *self,
+    guint glycemia)
+{
+  g_return_if_fail (self != NULL);
+
+  glycemia = MIN (glycemia, OG_GLYCEMIA_MAX);
+  self->bins[glycemia / OG_QUANTILE_SKETCH_BIN_WIDTH]++;
+  self->n_values++;
+}
+
+void
+og_quantile_sketch_merge (OgQuantileSketch *self,
+    const OgQuantileSketch *other)
+{
+  guint i;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (other != NULL);
+
+  for (i = 0; i < OG_QUANTILE_SKETCH_N_BINS; i++)
+    self->bins[i] += other->bins[i];
+  self->n_values += other->n_values;
+}
+
+/* Returns the value below which @quantile of the readings are, assuming
+ * readings are evenly spread within each bin. */
+gdouble
+og_quantile_sketch_get (const OgQuantileSketch *self,
+    gdouble quantile)
+{
+  gdouble rank;
+  guint32 below = 0;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (quantile >= 0 && quantile <= 1, 0);
+
+  if (self->n_values == 0)
+    return 0;
+
+  rank = quantile * self->n_values;
+  for (i = 0; i < OG_QUANTILE_SKETCH_N_BINS; i++)
+    {
+      if (self->bins[i] > 0 && below + self->bins[i] >= rank)
+        return OG_QUANTILE_SKETCH_BIN_WIDTH *
+            (i + (rank - below) / self->bins[i]);
+
+      below += self->bins[i];
+    }
+
+  return OG_GLYCEMIA_MAX;
+}
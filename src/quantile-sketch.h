@@ -0,0 +1,34 @@
+#ifndef __OG_QUANTILE_SKETCH_H__
+#define __OG_QUANTILE_SKETCH_H__
+
+#include <glib.h>
+
+#include "record.h"
+
+G_BEGIN_DECLS
+
+/* Quantiles are estimated within half that width, in mg/dl */
+#define OG_QUANTILE_SKETCH_BIN_WIDTH 5
+#define OG_QUANTILE_SKETCH_N_BINS \
+    (OG_GLYCEMIA_MAX / OG_QUANTILE_SKETCH_BIN_WIDTH + 1)
+
+/* Streaming quantile estimator of glycemia readings. Since readings are
+ * bounded it is a fixed-size histogram: adding a value is O(1), memory does
+ * not grow with the number of values, and sketches of different days or
+ * devices are merged by adding them. Zero-initialize it before use. */
+typedef struct
+{
+  guint32 n_values;
+  guint32 bins[OG_QUANTILE_SKETCH_N_BINS];
+} OgQuantileSketch;
+
+void og_quantile_sketch_add (OgQuantileSketch *self,
+    guint glycemia);
+void og_quantile_sketch_merge (OgQuantileSketch *self,
+    const OgQuantileSketch *other);
+gdouble og_quantile_sketch_get (const OgQuantileSketch *self,
+    gdouble quantile);
+
+G_END_DECLS
+
+#endif /* __OG_QUANTILE_SKETCH_H__ */
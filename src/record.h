@@ -5,10 +5,30 @@
 
 G_BEGIN_DECLS
 
+/* Readings above that, in mg/dl, are accounted as that value in histograms */
+#define OG_GLYCEMIA_MAX 600
+
+#define OG_SECONDS_PER_DAY (24 * 60 * 60)
+
+/* When the reading was taken, as tagged on the device */
+typedef enum
+{
+  OG_MEAL_TAG_NONE,
+  OG_MEAL_TAG_FASTING,
+  OG_MEAL_TAG_BEFORE,
+  OG_MEAL_TAG_AFTER,
+} OgMealTag;
+#define OG_N_MEAL_TAGS (OG_MEAL_TAG_AFTER + 1)
+
 typedef struct
 {
   GDateTime *datetime;
   guint glycemia;
+  OgMealTag meal_tag;
+  /* 0 if not measured */
+  guint ketone;
+  /* 0 if none */
+  guint smart_tag;
 } OgRecord;
 
 OgRecord *og_record_new (guint year,
@@ -0,0 +1,186 @@
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "kernels.h"
+#include "stats.h"
+#include "variability.h"
+
+/* Times the statistics queries over synthetic readings, one every 5 minutes
+ * back from now, as a CGM would take them:
+ *
+ *   OPENGLUCOSE_KERNELS=scalar ./stats-benchmark [n_readings]
+ *
+ * Queries cached by the stats are timed on their first call, the others are
+ * averaged over N_RUNS calls. Variability indices are timed on growing
+ * prefixes of the history, so their cost per reading shows they are
+ * linear. */
+
+#define DEFAULT_N_READINGS 1000000
+#define N_RUNS 100
+#define READING_INTERVAL (5 * 60)
+
+static gdouble
+get_ms (gint64 start)
+{
+  return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+/* The oldest @n_readings of @values, which are newest first, in time order
+ * as the device model feeds them */
+static void
+time_variability (const guint16 *values,
+    guint n_values,
+    guint n_readings,
+    gint64 now)
+{
+  OgVariabilityBuilder *builder;
+  OgVariability variability;
+  gint64 start;
+  gdouble ms;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  builder = og_variability_builder_new ();
+  for (i = n_values - n_readings; i < n_values; i++)
+    og_variability_builder_add (builder,
+        now - (gint64) (n_values - 1 - i) * READING_INTERVAL,
+        values[n_values - 1 - i]);
+  og_variability_builder_finish (builder, &variability);
+  og_variability_builder_free (builder);
+  ms = get_ms (start);
+
+  g_print ("variability, %7u: %10.3f ms, %6.1f ns/reading "
+      "(MAGE %.1f, CONGA %.1f, MODD %.1f, LBGI %.2f, HBGI %.2f)\n",
+      n_readings, ms, n_readings > 0 ? ms * 1e6 / n_readings : 0,
+      variability.mage, variability.conga, variability.modd,
+      variability.lbgi, variability.hbgi);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  OgStats *stats;
+  GDateTime *now;
+  GRand *rng;
+  GArray *glycemia;
+  GArray *minutes;
+  guint16 *values;
+  guint16 *pairs;
+  guint64 sums[OG_MINUTES_PER_DAY];
+  guint counts[OG_MINUTES_PER_DAY];
+  guint n_hypo, n_good, n_hyper;
+  guint16 min, max;
+  guint n_readings;
+  gint64 start;
+  guint i, j;
+
+  n_readings = argc > 1 ? strtoul (argv[1], NULL, 10) : DEFAULT_N_READINGS;
+
+  now = g_date_time_new_now_local ();
+  stats = og_stats_new (now);
+  rng = g_rand_new_with_seed (0);
+  values = g_new (guint16, MAX (n_readings, 1));
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_readings; i++)
+    {
+      OgRecord record = { NULL, };
+
+      record.datetime = g_date_time_add_seconds (now,
+          -READING_INTERVAL * (gdouble) i);
+      record.glycemia = g_rand_int_range (rng, 40, OG_GLYCEMIA_MAX + 1);
+      values[i] = record.glycemia;
+      record.meal_tag = g_rand_int_range (rng, 0, OG_N_MEAL_TAGS);
+      og_stats_add_record (stats, &record);
+      g_date_time_unref (record.datetime);
+    }
+  g_print ("%u readings, %s kernels\n", n_readings, og_kernels_get_name ());
+  g_print ("add records:        %10.3f ms\n", get_ms (start));
+
+  /* Thresholds change at each run, as when moving the spin buttons */
+  start = g_get_monotonic_time ();
+  og_stats_classify (stats, OG_TIME_SPAN_ALL, OG_HYPOGLYCEMIA,
+      OG_HYPERGLYCEMIA, &n_hypo, &n_good, &n_hyper);
+  g_print ("classify, first:    %10.3f ms\n", get_ms (start));
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_RUNS; i++)
+    og_stats_classify (stats, OG_TIME_SPAN_ALL, OG_HYPOGLYCEMIA + i,
+        OG_HYPERGLYCEMIA + i, &n_hypo, &n_good, &n_hyper);
+  g_print ("classify:           %10.3f ms (%u, %u, %u)\n",
+      get_ms (start) / N_RUNS, n_hypo, n_good, n_hyper);
+
+  start = g_get_monotonic_time ();
+  og_stats_get_span (stats, OG_TIME_SPAN_ALL);
+  g_print ("span, first:        %10.3f ms\n", get_ms (start));
+
+  start = g_get_monotonic_time ();
+  og_stats_get_modal_day (stats, OG_TIME_SPAN_ALL, OG_MEAL_TAG_ANY);
+  g_print ("modal day, first:   %10.3f ms\n", get_ms (start));
+
+  /* The kernels themselves, on all readings packed in a single array */
+  glycemia = g_array_new (FALSE, FALSE, sizeof (guint16));
+  minutes = g_array_new (FALSE, FALSE, sizeof (guint16));
+  for (i = 0; i < OG_N_TIME_SPANS; i++)
+    for (j = 0; j < OG_N_MEAL_TAGS; j++)
+      {
+        const guint16 *class_glycemia;
+        const guint16 *class_minutes;
+        guint n;
+
+        class_glycemia = og_stats_get_readings (stats, i, j, &class_minutes,
+            &n);
+        g_array_append_vals (glycemia, class_glycemia, n);
+        g_array_append_vals (minutes, class_minutes, n);
+      }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_RUNS; i++)
+    {
+      min = G_MAXUINT16;
+      max = 0;
+      og_kernels_min_max ((const guint16 *) glycemia->data, glycemia->len,
+          &min, &max);
+    }
+  g_print ("min/max:            %10.3f ms (%u, %u)\n",
+      get_ms (start) / N_RUNS, min, max);
+
+  /* As the modal day chart data packs its batches of readings */
+  pairs = g_new (guint16, 2 * MAX (glycemia->len, 1));
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_RUNS; i++)
+    og_kernels_interleave ((const guint16 *) minutes->data,
+        (const guint16 *) glycemia->data, glycemia->len, pairs);
+  g_print ("interleave:         %10.3f ms\n", get_ms (start) / N_RUNS);
+
+  memset (sums, 0, sizeof (sums));
+  memset (counts, 0, sizeof (counts));
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_RUNS; i++)
+    og_kernels_bucket_sums ((const guint16 *) glycemia->data,
+        (const guint16 *) minutes->data, glycemia->len, 1,
+        OG_MINUTES_PER_DAY, sums, counts);
+  g_print ("bucket sums:        %10.3f ms (%u)\n",
+      get_ms (start) / N_RUNS, counts[0] / N_RUNS);
+
+  time_variability (values, n_readings, n_readings / 100,
+      g_date_time_to_unix (now));
+  time_variability (values, n_readings, n_readings / 10,
+      g_date_time_to_unix (now));
+  time_variability (values, n_readings, n_readings,
+      g_date_time_to_unix (now));
+
+  g_free (values);
+  g_free (pairs);
+  g_array_unref (glycemia);
+  g_array_unref (minutes);
+  g_rand_free (rng);
+  og_stats_free (stats);
+  g_date_time_unref (now);
+
+  return EXIT_SUCCESS;
+}
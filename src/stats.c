@@ -0,0 +1,622 @@
+#include "config.h"
+
+#include "stats.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "kernels.h"
+
+static const gint span_n_days[OG_N_TIME_SPANS] = {
+  7,   /* OG_TIME_SPAN_1W */
+  14,  /* OG_TIME_SPAN_2W */
+  30,  /* OG_TIME_SPAN_1M */
+  60,  /* OG_TIME_SPAN_2M */
+  365, /* OG_TIME_SPAN_1Y */
+  -1,  /* OG_TIME_SPAN_ALL */
+};
+
+const gdouble og_agp_percentiles[OG_AGP_N_PERCENTILES] = {
+  0.05, 0.25, 0.50, 0.75, 0.95
+};
+
+#define N_BINS (OG_GLYCEMIA_MAX + 1)
+
+/* Number of readings of a day, by mg/dl value. Once cumulative, counts[v] is
+ * the number of readings below v, and counts[N_BINS] the total. */
+typedef struct
+{
+  guint16 counts[N_BINS + 1];
+  gboolean cumulative;
+} DayHistogram;
+
+struct _OgStats
+{
+  gint today;
+  guint n_records;
+
+  /* Indexed by the number of days before today, NULL for days without
+   * records */
+  GPtrArray *days;
+
+  /* Each record is accounted only in the shortest span containing it, spans
+   * are then the sum of all shorter classes. */
+  OgSpanStats classes[OG_N_TIME_SPANS];
+
+  /* Per class and meal tag, readings packed for the kernels: GArray<guint16>
+   * of glycemia, clamped to OG_GLYCEMIA_MAX, and of their minute of the day.
+   * Segments are partitions, so unsegmented queries scan them all. */
+  GArray *glycemia[OG_N_TIME_SPANS][OG_N_MEAL_TAGS];
+  GArray *minutes[OG_N_TIME_SPANS][OG_N_MEAL_TAGS];
+
+  /* Bitmask of classes whose buckets and range are up to date */
+  guint classes_valid;
+  OgSpanStats spans[OG_N_TIME_SPANS];
+  gboolean spans_valid;
+
+  /* Per span and meal tag or OG_MEAL_TAG_ANY, computed on demand. Per meal
+   * tag, bitmask of spans up to date. */
+  OgModalDay *modal_days[OG_N_TIME_SPANS][OG_N_MEAL_TAGS + 1];
+  guint modal_days_valid[OG_N_MEAL_TAGS + 1];
+
+  /* Per class, OG_AGP_N_BINS sketches or NULL if the class is empty */
+  OgQuantileSketch *agp_classes[OG_N_TIME_SPANS];
+};
+
+void
+og_moments_add (OgMoments *self,
+    gdouble value)
+{
+  gdouble delta;
+
+  g_return_if_fail (self != NULL);
+
+  self->n_values++;
+  delta = value - self->mean;
+  self->mean += delta / self->n_values;
+  self->m2 += delta * (value - self->mean);
+}
+
+void
+og_moments_merge (OgMoments *self,
+    const OgMoments *other)
+{
+  gdouble delta;
+  guint n_values;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (other != NULL);
+
+  if (other->n_values == 0)
+    return;
+
+  n_values = self->n_values + other->n_values;
+  delta = other->mean - self->mean;
+  self->mean += delta * other->n_values / n_values;
+  self->m2 += other->m2 +
+      delta * delta * ((gdouble) self->n_values * other->n_values / n_values);
+  self->n_values = n_values;
+}
+
+/* Sample standard deviation, in mg/dl */
+gdouble
+og_moments_get_sd (const OgMoments *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  if (self->n_values < 2)
+    return 0;
+
+  return sqrt (self->m2 / (self->n_values - 1));
+}
+
+/* Coefficient of variation, in percent */
+gdouble
+og_moments_get_cv (const OgMoments *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  if (self->mean <= 0)
+    return 0;
+
+  return 100 * og_moments_get_sd (self) / self->mean;
+}
+
+/* Glucose Management Indicator, in percent, from the mean in mg/dl */
+gdouble
+og_glycemia_get_gmi (gdouble mean)
+{
+  return 3.31 + 0.02392 * mean;
+}
+
+/* Estimated A1c (ADAG), in percent, from the mean in mg/dl */
+gdouble
+og_glycemia_get_ea1c (gdouble mean)
+{
+  return (mean + 46.7) / 28.7;
+}
+
+gint
+og_time_span_get_n_days (OgTimeSpan span)
+{
+  g_return_val_if_fail (span < OG_N_TIME_SPANS, -1);
+
+  return span_n_days[span];
+}
+
+/* Number of days since epoch, in the timezone of @dt */
+static gint
+get_day_number (GDateTime *dt)
+{
+  gint64 local;
+
+  local = g_date_time_to_unix (dt) +
+      g_date_time_get_utc_offset (dt) / G_TIME_SPAN_SECOND;
+
+  return local / (24 * 60 * 60);
+}
+
+OgStats *
+og_stats_new (GDateTime *now)
+{
+  OgStats *self;
+  guint i, j;
+
+  g_return_val_if_fail (now != NULL, NULL);
+
+  self = g_slice_new0 (OgStats);
+  self->today = get_day_number (now);
+  self->days = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; i < OG_N_TIME_SPANS; i++)
+    for (j = 0; j < OG_N_MEAL_TAGS; j++)
+      {
+        self->glycemia[i][j] = g_array_new (FALSE, FALSE, sizeof (guint16));
+        self->minutes[i][j] = g_array_new (FALSE, FALSE, sizeof (guint16));
+      }
+
+  return self;
+}
+
+void
+og_stats_free (OgStats *self)
+{
+  guint i, j;
+
+  if (self == NULL)
+    return;
+
+  for (i = 0; i < OG_N_TIME_SPANS; i++)
+    {
+      for (j = 0; j < OG_N_MEAL_TAGS; j++)
+        {
+          g_array_unref (self->glycemia[i][j]);
+          g_array_unref (self->minutes[i][j]);
+        }
+      for (j = 0; j <= OG_N_MEAL_TAGS; j++)
+        g_free (self->modal_days[i][j]);
+      g_free (self->agp_classes[i]);
+    }
+  g_ptr_array_unref (self->days);
+  g_slice_free (OgStats, self);
+}
+
+gsize
+og_stats_get_size (const OgStats *self)
+{
+  gsize size;
+  guint i, j;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  size = sizeof (OgStats) + self->days->len * sizeof (gpointer);
+  for (i = 0; i < self->days->len; i++)
+    {
+      if (g_ptr_array_index (self->days, i) != NULL)
+        size += sizeof (DayHistogram);
+    }
+  for (i = 0; i < OG_N_TIME_SPANS; i++)
+    {
+      for (j = 0; j < OG_N_MEAL_TAGS; j++)
+        size += 2 * self->glycemia[i][j]->len * sizeof (guint16);
+      for (j = 0; j <= OG_N_MEAL_TAGS; j++)
+        {
+          if (self->modal_days[i][j] != NULL)
+            size += sizeof (OgModalDay);
+        }
+      if (self->agp_classes[i] != NULL)
+        size += OG_AGP_N_BINS * sizeof (OgQuantileSketch);
+    }
+
+  return size;
+}
+
+gboolean
+og_stats_is_current (const OgStats *self,
+    GDateTime *now)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return self->today == get_day_number (now);
+}
+
+guint
+og_stats_get_n_records (const OgStats *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_records;
+}
+
+/* Number of days before today. Records in the future, if device clock is
+ * wrong, count as today's. */
+static guint
+get_record_age (const OgStats *self,
+    const OgRecord *record)
+{
+  return MAX (self->today - get_day_number (record->datetime), 0);
+}
+
+OgTimeSpan
+og_stats_get_record_span (const OgStats *self,
+    const OgRecord *record)
+{
+  guint age;
+  OgTimeSpan span;
+
+  g_return_val_if_fail (self != NULL, OG_TIME_SPAN_ALL);
+  g_return_val_if_fail (record != NULL, OG_TIME_SPAN_ALL);
+
+  age = get_record_age (self, record);
+  for (span = OG_TIME_SPAN_1W; span < OG_TIME_SPAN_ALL; span++)
+    {
+      if (age < (guint) span_n_days[span])
+        break;
+    }
+
+  return span;
+}
+
+static void
+day_histogram_add (DayHistogram *day,
+    guint glycemia)
+{
+  guint v;
+
+  glycemia = MIN (glycemia, OG_GLYCEMIA_MAX);
+
+  if (!day->cumulative)
+    {
+      day->counts[glycemia]++;
+      return;
+    }
+
+  /* Only happens when records are added after a query */
+  for (v = glycemia + 1; v <= N_BINS; v++)
+    day->counts[v]++;
+}
+
+static void
+day_histogram_make_cumulative (DayHistogram *day)
+{
+  guint16 total = 0;
+  guint v;
+
+  if (day->cumulative)
+    return;
+
+  for (v = 0; v <= N_BINS; v++)
+    {
+      guint16 count = day->counts[v];
+
+      day->counts[v] = total;
+      total += count;
+    }
+  day->cumulative = TRUE;
+}
+
+void
+og_stats_add_record (OgStats *self,
+    const OgRecord *record)
+{
+  OgTimeSpan span;
+  OgSpanStats *class;
+  OgMealTag meal_tag;
+  DayHistogram *day;
+  guint16 glycemia;
+  guint16 minute_of_day;
+  guint age;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (record != NULL);
+
+  span = og_stats_get_record_span (self, record);
+  meal_tag = record->meal_tag < OG_N_MEAL_TAGS ?
+      record->meal_tag : OG_MEAL_TAG_NONE;
+  class = &self->classes[span];
+  class->n_values++;
+  og_moments_add (&class->moments, record->glycemia);
+  og_moments_add (&class->meals[meal_tag], record->glycemia);
+
+  minute_of_day = g_date_time_get_hour (record->datetime) * 60 +
+      g_date_time_get_minute (record->datetime);
+
+  glycemia = MIN (record->glycemia, OG_GLYCEMIA_MAX);
+  g_array_append_val (self->glycemia[span][meal_tag], glycemia);
+  g_array_append_val (self->minutes[span][meal_tag], minute_of_day);
+
+  if (self->agp_classes[span] == NULL)
+    self->agp_classes[span] = g_new0 (OgQuantileSketch, OG_AGP_N_BINS);
+  og_quantile_sketch_add (
+      &self->agp_classes[span][minute_of_day * OG_AGP_N_BINS / (24 * 60)],
+      record->glycemia);
+
+  age = get_record_age (self, record);
+  if (age >= self->days->len)
+    g_ptr_array_set_size (self->days, age + 1);
+  day = g_ptr_array_index (self->days, age);
+  if (day == NULL)
+    {
+      day = g_new0 (DayHistogram, 1);
+      g_ptr_array_index (self->days, age) = day;
+    }
+  day_histogram_add (day, record->glycemia);
+
+  self->n_records++;
+  self->classes_valid &= ~(1 << span);
+  /* Spans including that class */
+  self->modal_days_valid[meal_tag] &= (1 << span) - 1;
+  self->modal_days_valid[OG_MEAL_TAG_ANY] &= (1 << span) - 1;
+  self->spans_valid = FALSE;
+}
+
+static void
+span_stats_merge (OgSpanStats *dest,
+    const OgSpanStats *src)
+{
+  guint i;
+
+  if (src->n_values == 0)
+    return;
+
+  dest->min = dest->n_values > 0 ? MIN (dest->min, src->min) : src->min;
+  dest->max = MAX (dest->max, src->max);
+  dest->n_values += src->n_values;
+  og_moments_merge (&dest->moments, &src->moments);
+  for (i = 0; i < OG_N_MEAL_TAGS; i++)
+    og_moments_merge (&dest->meals[i], &src->meals[i]);
+}
+
+/* The range is computed in bulk from packed readings, only when the class got
+ * new records since last query. */
+static void
+update_class (OgStats *self,
+    OgTimeSpan span)
+{
+  OgSpanStats *class = &self->classes[span];
+  guint16 min = G_MAXUINT16;
+  guint16 max = 0;
+  guint i;
+
+  if (self->classes_valid & (1 << span))
+    return;
+
+  for (i = 0; i < OG_N_MEAL_TAGS; i++)
+    og_kernels_min_max ((const guint16 *) self->glycemia[span][i]->data,
+        self->glycemia[span][i]->len, &min, &max);
+  class->min = min;
+  class->max = max;
+
+  self->classes_valid |= 1 << span;
+}
+
+const OgSpanStats *
+og_stats_get_span (OgStats *self,
+    OgTimeSpan span)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (span < OG_N_TIME_SPANS, NULL);
+
+  if (!self->spans_valid)
+    {
+      OgTimeSpan i;
+
+      memset (self->spans, 0, sizeof (self->spans));
+      for (i = 0; i < OG_N_TIME_SPANS; i++)
+        {
+          update_class (self, i);
+          if (i > 0)
+            self->spans[i] = self->spans[i - 1];
+          span_stats_merge (&self->spans[i], &self->classes[i]);
+        }
+      self->spans_valid = TRUE;
+    }
+
+  return &self->spans[span];
+}
+
+/* Modal day of readings tagged @meal_tag, or of all of them if it is
+ * OG_MEAL_TAG_ANY */
+const OgModalDay *
+og_stats_get_modal_day (OgStats *self,
+    OgTimeSpan span,
+    guint meal_tag)
+{
+  OgModalDay *modal_day;
+  guint i, j;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (span < OG_N_TIME_SPANS, NULL);
+  g_return_val_if_fail (meal_tag <= OG_MEAL_TAG_ANY, NULL);
+
+  if (self->modal_days_valid[meal_tag] & (1 << span))
+    return self->modal_days[span][meal_tag];
+
+  if (self->modal_days[span][meal_tag] == NULL)
+    self->modal_days[span][meal_tag] = g_new (OgModalDay, 1);
+  modal_day = self->modal_days[span][meal_tag];
+  memset (modal_day, 0, sizeof (OgModalDay));
+
+  /* Per minute sums, shifted by one, then accumulated in place */
+  for (i = 0; i <= span; i++)
+    for (j = 0; j < OG_N_MEAL_TAGS; j++)
+      {
+        if (meal_tag != OG_MEAL_TAG_ANY && meal_tag != j)
+          continue;
+
+        og_kernels_bucket_sums ((const guint16 *) self->glycemia[i][j]->data,
+            (const guint16 *) self->minutes[i][j]->data,
+            self->glycemia[i][j]->len, 1, OG_MINUTES_PER_DAY,
+            modal_day->sums + 1, modal_day->counts + 1);
+      }
+  for (i = 1; i <= OG_MINUTES_PER_DAY; i++)
+    {
+      modal_day->counts[i] += modal_day->counts[i - 1];
+      modal_day->sums[i] += modal_day->sums[i - 1];
+    }
+
+  self->modal_days_valid[meal_tag] |= 1 << span;
+
+  return modal_day;
+}
+
+/* Aggregate readings taken in [@start, @end) minutes of the day. The window
+ * can wrap around midnight, with @start negative or @end past the end of the
+ * day, but cannot be longer than a day. Returns the number of readings and
+ * sets @mean if there are any. */
+guint
+og_modal_day_get_window (const OgModalDay *self,
+    gint start,
+    gint end,
+    gdouble *mean)
+{
+  guint count;
+  guint64 sum;
+
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (start <= end, 0);
+  g_return_val_if_fail (start > -OG_MINUTES_PER_DAY, 0);
+  g_return_val_if_fail (end >= 0 && start < OG_MINUTES_PER_DAY, 0);
+  g_return_val_if_fail (end - start <= OG_MINUTES_PER_DAY, 0);
+
+  if (start < 0)
+    {
+      count = self->counts[end] + self->counts[OG_MINUTES_PER_DAY] -
+          self->counts[start + OG_MINUTES_PER_DAY];
+      sum = self->sums[end] + self->sums[OG_MINUTES_PER_DAY] -
+          self->sums[start + OG_MINUTES_PER_DAY];
+    }
+  else if (end > OG_MINUTES_PER_DAY)
+    {
+      count = self->counts[OG_MINUTES_PER_DAY] - self->counts[start] +
+          self->counts[end - OG_MINUTES_PER_DAY];
+      sum = self->sums[OG_MINUTES_PER_DAY] - self->sums[start] +
+          self->sums[end - OG_MINUTES_PER_DAY];
+    }
+  else
+    {
+      count = self->counts[end] - self->counts[start];
+      sum = self->sums[end] - self->sums[start];
+    }
+
+  if (count > 0 && mean != NULL)
+    *mean = (gdouble) sum / count;
+
+  return count;
+}
+
+void
+og_stats_compute_agp (OgStats *self,
+    OgTimeSpan span,
+    OgAgp *agp)
+{
+  OgQuantileSketch sketch;
+  guint bin;
+  guint i;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (span < OG_N_TIME_SPANS);
+  g_return_if_fail (agp != NULL);
+
+  for (bin = 0; bin < OG_AGP_N_BINS; bin++)
+    {
+      memset (&sketch, 0, sizeof (sketch));
+      for (i = 0; i <= span; i++)
+        {
+          if (self->agp_classes[i] != NULL)
+            og_quantile_sketch_merge (&sketch, &self->agp_classes[i][bin]);
+        }
+
+      agp->n_values[bin] = sketch.n_values;
+      for (i = 0; i < OG_AGP_N_PERCENTILES; i++)
+        agp->percentiles[bin][i] = og_quantile_sketch_get (&sketch,
+            og_agp_percentiles[i]);
+    }
+}
+
+/* Count the readings of @span below @hypoglycemia, between both thresholds
+ * and above @hyperglycemia, in O(days) from the per-day histograms. */
+void
+og_stats_classify (OgStats *self,
+    OgTimeSpan span,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    guint *n_hypo,
+    guint *n_good,
+    guint *n_hyper)
+{
+  guint n_days;
+  guint below_hypo = 0;
+  guint below_hyper = 0;
+  guint total = 0;
+  guint i;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (span < OG_N_TIME_SPANS);
+  g_return_if_fail (hypoglycemia <= hyperglycemia);
+
+  hypoglycemia = MIN (hypoglycemia, N_BINS);
+  hyperglycemia = MIN (hyperglycemia, N_BINS);
+
+  n_days = self->days->len;
+  if (span_n_days[span] >= 0)
+    n_days = MIN (n_days, (guint) span_n_days[span]);
+
+  for (i = 0; i < n_days; i++)
+    {
+      DayHistogram *day = g_ptr_array_index (self->days, i);
+
+      if (day == NULL)
+        continue;
+
+      day_histogram_make_cumulative (day);
+      below_hypo += day->counts[hypoglycemia];
+      below_hyper += day->counts[hyperglycemia];
+      total += day->counts[N_BINS];
+    }
+
+  if (n_hypo != NULL)
+    *n_hypo = below_hypo;
+  if (n_good != NULL)
+    *n_good = below_hyper - below_hypo;
+  if (n_hyper != NULL)
+    *n_hyper = total - below_hyper;
+}
+
+const guint16 *
+og_stats_get_readings (const OgStats *self,
+    OgTimeSpan class,
+    OgMealTag meal_tag,
+    const guint16 **minutes,
+    guint *n_readings)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (class < OG_N_TIME_SPANS, NULL);
+  g_return_val_if_fail (meal_tag < OG_N_MEAL_TAGS, NULL);
+
+  if (minutes != NULL)
+    *minutes = (const guint16 *) self->minutes[class][meal_tag]->data;
+  if (n_readings != NULL)
+    *n_readings = self->glycemia[class][meal_tag]->len;
+
+  return (const guint16 *) self->glycemia[class][meal_tag]->data;
+}
@@ -0,0 +1,136 @@
+#ifndef __OG_STATS_H__
+#define __OG_STATS_H__
+
+#include <glib.h>
+
+#include "quantile-sketch.h"
+#include "record.h"
+
+G_BEGIN_DECLS
+
+/* Default thresholds, in mg/dl unit */
+#define OG_HYPOGLYCEMIA 60
+#define OG_HYPERGLYCEMIA 170
+
+/* Spans are made of whole days: the last 7 days are today and the 6 days
+ * before. Each span includes all the shorter ones. */
+typedef enum
+{
+  OG_TIME_SPAN_1W,
+  OG_TIME_SPAN_2W,
+  OG_TIME_SPAN_1M,
+  OG_TIME_SPAN_2M,
+  OG_TIME_SPAN_1Y,
+  OG_TIME_SPAN_ALL,
+} OgTimeSpan;
+#define OG_N_TIME_SPANS (OG_TIME_SPAN_ALL + 1)
+
+gint og_time_span_get_n_days (OgTimeSpan span);
+
+#define OG_MINUTES_PER_DAY (24 * 60)
+
+/* Readings of a span by minute of the day, as prefix sums: counts[m] and
+ * sums[m] are the number and the sum of readings taken before minute m. Any
+ * window of the day is then aggregated in O(1). */
+typedef struct
+{
+  guint counts[OG_MINUTES_PER_DAY + 1];
+  guint64 sums[OG_MINUTES_PER_DAY + 1];
+} OgModalDay;
+
+guint og_modal_day_get_window (const OgModalDay *self,
+    gint start,
+    gint end,
+    gdouble *mean);
+
+/* Running mean and sum of squared deviations of readings, updated with
+ * Welford's algorithm. Two of them are merged with Chan's formula so partial
+ * results, e.g. of different devices, can be combined. */
+typedef struct
+{
+  guint n_values;
+  gdouble mean;
+  gdouble m2;
+} OgMoments;
+
+void og_moments_add (OgMoments *self,
+    gdouble value);
+void og_moments_merge (OgMoments *self,
+    const OgMoments *other);
+gdouble og_moments_get_sd (const OgMoments *self);
+gdouble og_moments_get_cv (const OgMoments *self);
+
+gdouble og_glycemia_get_gmi (gdouble mean);
+gdouble og_glycemia_get_ea1c (gdouble mean);
+
+/* Readings of any meal tag, for segmented queries */
+#define OG_MEAL_TAG_ANY OG_N_MEAL_TAGS
+
+typedef struct
+{
+  guint n_values;
+  guint min;
+  guint max;
+  OgMoments moments;
+  /* Per OgMealTag */
+  OgMoments meals[OG_N_MEAL_TAGS];
+} OgSpanStats;
+
+/* Ambulatory Glucose Profile: percentiles of readings per 15 minutes of the
+ * time of day */
+#define OG_AGP_N_BINS 96
+#define OG_AGP_N_PERCENTILES 5
+
+extern const gdouble og_agp_percentiles[OG_AGP_N_PERCENTILES];
+
+typedef struct
+{
+  guint n_values[OG_AGP_N_BINS];
+  gdouble percentiles[OG_AGP_N_BINS][OG_AGP_N_PERCENTILES];
+} OgAgp;
+
+/* Aggregates of records over all time spans, built in a single pass as
+ * records are added. Spans are anchored to the day it was created. */
+typedef struct _OgStats OgStats;
+
+OgStats *og_stats_new (GDateTime *now);
+void og_stats_free (OgStats *self);
+gsize og_stats_get_size (const OgStats *self);
+
+gboolean og_stats_is_current (const OgStats *self,
+    GDateTime *now);
+guint og_stats_get_n_records (const OgStats *self);
+
+void og_stats_add_record (OgStats *self,
+    const OgRecord *record);
+
+OgTimeSpan og_stats_get_record_span (const OgStats *self,
+    const OgRecord *record);
+const OgSpanStats *og_stats_get_span (OgStats *self,
+    OgTimeSpan span);
+
+const OgModalDay *og_stats_get_modal_day (OgStats *self,
+    OgTimeSpan span,
+    guint meal_tag);
+
+void og_stats_compute_agp (OgStats *self,
+    OgTimeSpan span,
+    OgAgp *agp);
+
+void og_stats_classify (OgStats *self,
+    OgTimeSpan span,
+    guint hypoglycemia,
+    guint hyperglycemia,
+    guint *n_hypo,
+    guint *n_good,
+    guint *n_hyper);
+
+const guint16 *og_stats_get_readings (const OgStats *self,
+    OgTimeSpan class,
+    OgMealTag meal_tag,
+    const guint16 **minutes,
+    guint *n_readings);
+
+G_END_DECLS
+
+#endif /* __OG_STATS_H__ */
@@ -0,0 +1,419 @@
+#include "config.h"
+
+#include "timeline-chart.h"
+
+#include <glib/gi18n.h>
+
+#include "chart-drawing.h"
+
+G_DEFINE_TYPE (OgTimelineChart, og_timeline_chart, GTK_TYPE_DRAWING_AREA)
+
+/* Space around the plot area for the title and axis labels, in pixels */
+#define MARGIN_TOP 30
+#define MARGIN_BOTTOM 30
+#define MARGIN_LEFT 50
+#define MARGIN_RIGHT 20
+
+/* The glycemia axis goes up to a multiple of that, in mg/dl */
+#define VALUE_STEP 50
+
+/* Zooming in stops at that many seconds across the plot */
+#define MIN_DURATION (6 * 60 * 60)
+/* Each scroll step zooms by that factor */
+#define ZOOM_FACTOR 1.25
+
+/* Date labels are at least that far apart, in pixels */
+#define MIN_TICK_SPACING 90
+
+struct _OgTimelineChartPrivate
+{
+  /* Borrowed from the device, NULL until set */
+  const OgTimeline *timeline;
+  /* Visible range, in Unix time, only meaningful once has_range is set */
+  gboolean has_range;
+  gint64 start;
+  gint64 end;
+
+  guint hypoglycemia;
+  guint hyperglycemia;
+
+  gboolean dragging;
+  gdouble drag_x;
+  gint64 drag_start;
+};
+
+/* Intervals between date labels, and how they are formatted */
+static const struct
+{
+  gint64 seconds;
+  const gchar *format;
+} ticks[] = {
+  { 60 * 60, "%H:%M" },
+  { 3 * 60 * 60, "%H:%M" },
+  { 6 * 60 * 60, "%H:%M" },
+  { 12 * 60 * 60, "%H:%M" },
+  { OG_SECONDS_PER_DAY, "%d %b" },
+  { 2 * OG_SECONDS_PER_DAY, "%d %b" },
+  { 7 * OG_SECONDS_PER_DAY, "%d %b" },
+  { 14 * OG_SECONDS_PER_DAY, "%d %b" },
+  { 30 * OG_SECONDS_PER_DAY, "%b %Y" },
+  { 91 * OG_SECONDS_PER_DAY, "%b %Y" },
+  { 182 * OG_SECONDS_PER_DAY, "%b %Y" },
+  { 365 * OG_SECONDS_PER_DAY, "%Y" },
+  { 2 * 365 * OG_SECONDS_PER_DAY, "%Y" },
+  { 5 * 365 * OG_SECONDS_PER_DAY, "%Y" },
+};
+
+static void
+draw_axes (OgTimelineChart *self,
+    cairo_t *cr,
+    const OgChartArea *area)
+{
+  GtkWidget *widget = (GtkWidget *) self;
+  GDateTime *datetime;
+  GdkRGBA color;
+  gint64 utc_offset;
+  gint64 first_tick;
+  gint64 time;
+  guint value_step;
+  guint value;
+  guint tick;
+
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget),
+      gtk_widget_get_state_flags (widget), &color);
+
+  value_step = area->max_value > 8 * VALUE_STEP ? 2 * VALUE_STEP : VALUE_STEP;
+
+  /* The finest interval leaving enough room between labels */
+  for (tick = 0; tick < G_N_ELEMENTS (ticks) - 1; tick++)
+    {
+      if (area->width * ticks[tick].seconds / (area->end - area->start) >=
+          MIN_TICK_SPACING)
+        break;
+    }
+
+  /* Labels fall on local midnight and hours, as far as a fixed interval
+   * allows */
+  datetime = g_date_time_new_from_unix_local (area->start);
+  utc_offset = g_date_time_get_utc_offset (datetime) / G_TIME_SPAN_SECOND;
+  g_date_time_unref (datetime);
+  first_tick = area->start + utc_offset + ticks[tick].seconds - 1;
+  first_tick -= first_tick % ticks[tick].seconds + utc_offset;
+
+  /* Grid */
+  cairo_set_line_width (cr, 1);
+  cairo_set_source_rgba (cr, color.red, color.green, color.blue, 0.15);
+  for (time = first_tick; time <= area->end; time += ticks[tick].seconds)
+    {
+      gdouble x = (gint) og_chart_area_get_x (area, time) + 0.5;
+
+      cairo_move_to (cr, x, area->y);
+      cairo_line_to (cr, x, area->y + area->height);
+    }
+  for (value = 0; value <= area->max_value; value += value_step)
+    {
+      gdouble y = (gint) og_chart_area_get_y (area, value) + 0.5;
+
+      cairo_move_to (cr, area->x, y);
+      cairo_line_to (cr, area->x + area->width, y);
+    }
+  cairo_stroke (cr);
+
+  /* Labels */
+  gdk_cairo_set_source_rgba (cr, &color);
+  for (time = first_tick; time <= area->end; time += ticks[tick].seconds)
+    {
+      gchar *text;
+
+      datetime = g_date_time_new_from_unix_local (time);
+      text = g_date_time_format (datetime, ticks[tick].format);
+      og_chart_draw_text (widget, cr, text, og_chart_area_get_x (area, time),
+          area->y + area->height + 4, 0.5, 0);
+      g_free (text);
+      g_date_time_unref (datetime);
+    }
+  for (value = 0; value <= area->max_value; value += value_step)
+    {
+      gchar *text = g_strdup_printf ("%u", value);
+
+      og_chart_draw_text (widget, cr, text, area->x - 6,
+          og_chart_area_get_y (area, value), 1, 0.5);
+      g_free (text);
+    }
+
+  og_chart_draw_text (widget, cr, _("Timeline"),
+      area->x + area->width / 2, MARGIN_TOP / 2, 0.5, 0.5);
+}
+
+/* Keeps the visible range within the history, and not narrower than
+ * MIN_DURATION. The first time there are readings, it shows all of them.
+ * Returns FALSE if there is nothing to show. */
+static gboolean
+clamp_range (OgTimelineChart *self)
+{
+  gint64 first, last;
+  gint64 duration;
+
+  if (self->priv->timeline == NULL ||
+      !og_timeline_get_range (self->priv->timeline, &first, &last))
+    return FALSE;
+
+  last = MAX (last + 1, first + MIN_DURATION);
+  if (!self->priv->has_range)
+    {
+      self->priv->has_range = TRUE;
+      self->priv->start = first;
+      self->priv->end = last;
+      return TRUE;
+    }
+
+  duration = CLAMP (self->priv->end - self->priv->start,
+      MIN_DURATION, last - first);
+
+  self->priv->start = CLAMP (self->priv->start, first, last - duration);
+  self->priv->end = self->priv->start + duration;
+
+  return TRUE;
+}
+
+static gboolean
+draw (GtkWidget *widget,
+    cairo_t *cr)
+{
+  OgTimelineChart *self = (OgTimelineChart *) widget;
+  const OgTimelineBucket *buckets;
+  gint64 buckets_start;
+  gint64 seconds;
+  guint n_buckets;
+  guint level;
+  guint max_value = 0;
+  gboolean in_line;
+  OgChartArea area;
+  guint i;
+
+  area.x = MARGIN_LEFT;
+  area.y = MARGIN_TOP;
+  area.width = gtk_widget_get_allocated_width (widget) -
+      MARGIN_LEFT - MARGIN_RIGHT;
+  area.height = gtk_widget_get_allocated_height (widget) -
+      MARGIN_TOP - MARGIN_BOTTOM;
+  if (area.width <= 0 || area.height <= 0 || !clamp_range (self))
+    return FALSE;
+  area.start = self->priv->start;
+  area.end = self->priv->end;
+
+  /* About one bucket per pixel, whatever the zoom */
+  level = og_timeline_get_level (
+      (gint64) ((area.end - area.start) / area.width));
+  seconds = og_timeline_get_bucket_seconds (level);
+  buckets = og_timeline_get_buckets (self->priv->timeline, level,
+      area.start, area.end, &buckets_start, &n_buckets);
+  for (i = 0; i < n_buckets; i++)
+    max_value = MAX (max_value, buckets[i].max);
+
+  /* Thresholds bands are always fully visible */
+  area.max_value = MAX (max_value, self->priv->hyperglycemia) + VALUE_STEP;
+  area.max_value -= area.max_value % VALUE_STEP;
+
+  og_chart_draw_threshold_bands (cr, &area, self->priv->hypoglycemia,
+      self->priv->hyperglycemia);
+  draw_axes (self, cr, &area);
+
+  cairo_rectangle (cr, area.x, area.y, area.width, area.height);
+  cairo_clip (cr);
+
+  /* Range of each bucket, all in a single path */
+  cairo_set_source_rgba (cr, 0.29, 0.70, 0.77, 0.6);
+  for (i = 0; i < n_buckets; i++)
+    {
+      gdouble x, right, top, bottom;
+
+      if (buckets[i].n_values == 0)
+        continue;
+
+      x = og_chart_area_get_x (&area, buckets_start + i * seconds);
+      right = og_chart_area_get_x (&area,
+          buckets_start + (i + 1) * seconds);
+      top = og_chart_area_get_y (&area, buckets[i].max);
+      bottom = og_chart_area_get_y (&area, buckets[i].min);
+      cairo_rectangle (cr, x, top, MAX (right - x, 1), MAX (bottom - top, 1));
+    }
+  cairo_fill (cr);
+
+  /* Mean, broken where there are no readings */
+  cairo_set_line_width (cr, 1.5);
+  cairo_set_source_rgb (cr, 0.92, 0.64, 0.16);
+  in_line = FALSE;
+  for (i = 0; i < n_buckets; i++)
+    {
+      gdouble x, y;
+
+      if (buckets[i].n_values == 0)
+        {
+          in_line = FALSE;
+          continue;
+        }
+
+      x = og_chart_area_get_x (&area,
+          buckets_start + i * seconds + seconds / 2);
+      y = og_chart_area_get_y (&area, buckets[i].sum / buckets[i].n_values);
+      if (in_line)
+        cairo_line_to (cr, x, y);
+      else
+        cairo_move_to (cr, x, y);
+      in_line = TRUE;
+    }
+  cairo_stroke (cr);
+
+  return FALSE;
+}
+
+static gboolean
+scroll_event (GtkWidget *widget,
+    GdkEventScroll *event)
+{
+  OgTimelineChart *self = (OgTimelineChart *) widget;
+  gint64 duration;
+  gdouble width;
+  gdouble ratio;
+  gint64 pointer;
+
+  width = gtk_widget_get_allocated_width (widget) - MARGIN_LEFT - MARGIN_RIGHT;
+  if (width <= 0 || !clamp_range (self))
+    return FALSE;
+
+  duration = self->priv->end - self->priv->start;
+  ratio = CLAMP ((event->x - MARGIN_LEFT) / width, 0, 1);
+  pointer = self->priv->start + duration * ratio;
+
+  if (event->direction == GDK_SCROLL_UP)
+    duration /= ZOOM_FACTOR;
+  else if (event->direction == GDK_SCROLL_DOWN)
+    duration *= ZOOM_FACTOR;
+  else
+    return FALSE;
+
+  /* The time under the pointer stays there */
+  self->priv->start = pointer - duration * ratio;
+  self->priv->end = self->priv->start + duration;
+  clamp_range (self);
+
+  gtk_widget_queue_draw (widget);
+
+  return TRUE;
+}
+
+static gboolean
+button_press_event (GtkWidget *widget,
+    GdkEventButton *event)
+{
+  OgTimelineChart *self = (OgTimelineChart *) widget;
+
+  if (event->button != GDK_BUTTON_PRIMARY || !clamp_range (self))
+    return FALSE;
+
+  self->priv->dragging = TRUE;
+  self->priv->drag_x = event->x;
+  self->priv->drag_start = self->priv->start;
+
+  return TRUE;
+}
+
+static gboolean
+button_release_event (GtkWidget *widget,
+    GdkEventButton *event)
+{
+  OgTimelineChart *self = (OgTimelineChart *) widget;
+
+  if (event->button != GDK_BUTTON_PRIMARY)
+    return FALSE;
+
+  self->priv->dragging = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+motion_notify_event (GtkWidget *widget,
+    GdkEventMotion *event)
+{
+  OgTimelineChart *self = (OgTimelineChart *) widget;
+  gint64 duration;
+  gdouble width;
+
+  width = gtk_widget_get_allocated_width (widget) - MARGIN_LEFT - MARGIN_RIGHT;
+  if (!self->priv->dragging || width <= 0 || !clamp_range (self))
+    return FALSE;
+
+  duration = self->priv->end - self->priv->start;
+  self->priv->start = self->priv->drag_start -
+      duration * (event->x - self->priv->drag_x) / width;
+  self->priv->end = self->priv->start + duration;
+  clamp_range (self);
+
+  gtk_widget_queue_draw (widget);
+
+  return TRUE;
+}
+
+static void
+og_timeline_chart_init (OgTimelineChart *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      OG_TYPE_TIMELINE_CHART, OgTimelineChartPrivate);
+
+  gtk_widget_add_events ((GtkWidget *) self, GDK_SCROLL_MASK |
+      GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
+      GDK_BUTTON1_MOTION_MASK);
+}
+
+static void
+og_timeline_chart_class_init (OgTimelineChartClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  widget_class->draw = draw;
+  widget_class->scroll_event = scroll_event;
+  widget_class->button_press_event = button_press_event;
+  widget_class->button_release_event = button_release_event;
+  widget_class->motion_notify_event = motion_notify_event;
+
+  g_type_class_add_private (object_class, sizeof (OgTimelineChartPrivate));
+}
+
+GtkWidget *
+og_timeline_chart_new (void)
+{
+  return g_object_new (OG_TYPE_TIMELINE_CHART, NULL);
+}
+
+/* @timeline must outlive the chart, it is drawn as it is at each redraw.
+ * Resets the visible range to the whole history, as soon as it has
+ * readings. */
+void
+og_timeline_chart_set_timeline (OgTimelineChart *self,
+    const OgTimeline *timeline)
+{
+  g_return_if_fail (OG_IS_TIMELINE_CHART (self));
+  g_return_if_fail (timeline != NULL);
+
+  self->priv->timeline = timeline;
+  self->priv->has_range = FALSE;
+  self->priv->dragging = FALSE;
+
+  gtk_widget_queue_draw ((GtkWidget *) self);
+}
+
+void
+og_timeline_chart_set_thresholds (OgTimelineChart *self,
+    guint hypoglycemia,
+    guint hyperglycemia)
+{
+  g_return_if_fail (OG_IS_TIMELINE_CHART (self));
+
+  self->priv->hypoglycemia = hypoglycemia;
+  self->priv->hyperglycemia = hyperglycemia;
+
+  gtk_widget_queue_draw ((GtkWidget *) self);
+}
@@ -0,0 +1,52 @@
+#ifndef __OG_TIMELINE_CHART_H__
+#define __OG_TIMELINE_CHART_H__
+
+#include <gtk/gtk.h>
+
+#include "timeline.h"
+
+G_BEGIN_DECLS
+
+#define OG_TYPE_TIMELINE_CHART \
+    (og_timeline_chart_get_type ())
+#define OG_TIMELINE_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST ((obj), OG_TYPE_TIMELINE_CHART, \
+        OgTimelineChart))
+#define OG_TIMELINE_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST ((klass), OG_TYPE_TIMELINE_CHART, \
+        OgTimelineChartClass))
+#define OG_IS_TIMELINE_CHART(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE ((obj), OG_TYPE_TIMELINE_CHART))
+#define OG_IS_TIMELINE_CHART_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE ((klass), OG_TYPE_TIMELINE_CHART))
+#define OG_TIMELINE_CHART_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS ((obj), OG_TYPE_TIMELINE_CHART, \
+        OgTimelineChartClass))
+
+typedef struct _OgTimelineChart OgTimelineChart;
+typedef struct _OgTimelineChartClass OgTimelineChartClass;
+typedef struct _OgTimelineChartPrivate OgTimelineChartPrivate;
+
+struct _OgTimelineChart {
+  GtkDrawingArea parent;
+
+  OgTimelineChartPrivate *priv;
+};
+
+struct _OgTimelineChartClass {
+  GtkDrawingAreaClass parent_class;
+};
+
+GType og_timeline_chart_get_type (void) G_GNUC_CONST;
+
+GtkWidget *og_timeline_chart_new (void);
+
+void og_timeline_chart_set_timeline (OgTimelineChart *self,
+    const OgTimeline *timeline);
+void og_timeline_chart_set_thresholds (OgTimelineChart *self,
+    guint hypoglycemia,
+    guint hyperglycemia);
+
+G_END_DECLS
+
+#endif /* __OG_TIMELINE_CHART_H__ */
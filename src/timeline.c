@@ -0,0 +1,193 @@
+#include "config.h"
+
+#include "timeline.h"
+
+#include "indexed-array.h"
+
+struct _OgTimeline
+{
+  guint n_records;
+  /* Unix times of the oldest and newest readings */
+  gint64 first;
+  gint64 last;
+
+  /* Per level, GArray<OgTimelineBucket> and index of its first bucket, in
+   * buckets since the Unix epoch */
+  GArray *levels[OG_TIMELINE_N_LEVELS];
+  gint64 offsets[OG_TIMELINE_N_LEVELS];
+};
+
+OgTimeline *
+og_timeline_new (void)
+{
+  OgTimeline *self;
+  guint i;
+
+  self = g_slice_new0 (OgTimeline);
+  for (i = 0; i < OG_TIMELINE_N_LEVELS; i++)
+    self->levels[i] = g_array_new (FALSE, TRUE, sizeof (OgTimelineBucket));
+
+  return self;
+}
+
+void
+og_timeline_free (OgTimeline *self)
+{
+  guint i;
+
+  if (self == NULL)
+    return;
+
+  for (i = 0; i < OG_TIMELINE_N_LEVELS; i++)
+    g_array_unref (self->levels[i]);
+  g_slice_free (OgTimeline, self);
+}
+
+gsize
+og_timeline_get_size (const OgTimeline *self)
+{
+  gsize size;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  size = sizeof (OgTimeline);
+  for (i = 0; i < OG_TIMELINE_N_LEVELS; i++)
+    size += self->levels[i]->len * sizeof (OgTimelineBucket);
+
+  return size;
+}
+
+guint
+og_timeline_get_n_records (const OgTimeline *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_records;
+}
+
+gint64
+og_timeline_get_bucket_seconds (guint level)
+{
+  g_return_val_if_fail (level < OG_TIMELINE_N_LEVELS, 0);
+
+  /* OG_TIMELINE_FANOUT is 4 */
+  return (gint64) OG_TIMELINE_BUCKET_SECONDS << (2 * level);
+}
+
+void
+og_timeline_add_record (OgTimeline *self,
+    const OgRecord *record)
+{
+  gint64 time;
+  guint16 glycemia;
+  guint i;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (record != NULL);
+
+  time = g_date_time_to_unix (record->datetime);
+  glycemia = MIN (record->glycemia, G_MAXUINT16);
+
+  if (self->n_records == 0)
+    {
+      self->first = time;
+      self->last = time;
+    }
+  self->first = MIN (self->first, time);
+  self->last = MAX (self->last, time);
+  self->n_records++;
+
+  for (i = 0; i < OG_TIMELINE_N_LEVELS; i++)
+    {
+      OgTimelineBucket *bucket;
+
+      bucket = og_indexed_array_get (self->levels[i], &self->offsets[i],
+          og_div_floor (time, og_timeline_get_bucket_seconds (i)));
+      if (bucket->n_values == 0)
+        {
+          bucket->min = glycemia;
+          bucket->max = glycemia;
+        }
+      bucket->min = MIN (bucket->min, glycemia);
+      bucket->max = MAX (bucket->max, glycemia);
+      bucket->sum += glycemia;
+      bucket->n_values++;
+    }
+}
+
+/* Unix times of the oldest and newest readings, FALSE if there are none */
+gboolean
+og_timeline_get_range (const OgTimeline *self,
+    gint64 *first,
+    gint64 *last)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  if (self->n_records == 0)
+    return FALSE;
+
+  if (first != NULL)
+    *first = self->first;
+  if (last != NULL)
+    *last = self->last;
+
+  return TRUE;
+}
+
+/* The finest level whose buckets are at least @seconds_per_bucket wide, e.g.
+ * the duration of a pixel */
+guint
+og_timeline_get_level (gint64 seconds_per_bucket)
+{
+  guint level;
+
+  for (level = 0; level < OG_TIMELINE_N_LEVELS - 1; level++)
+    {
+      if (og_timeline_get_bucket_seconds (level) >= seconds_per_bucket)
+        break;
+    }
+
+  return level;
+}
+
+/* Buckets of @level overlapping [@start, @end), in Unix time, clipped to those
+ * stored. @buckets_start is set to the start time of the first one. Returns
+ * NULL if there are none. */
+const OgTimelineBucket *
+og_timeline_get_buckets (const OgTimeline *self,
+    guint level,
+    gint64 start,
+    gint64 end,
+    gint64 *buckets_start,
+    guint *n_buckets)
+{
+  const GArray *buckets;
+  gint64 seconds;
+  gint64 first;
+  gint64 last;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (level < OG_TIMELINE_N_LEVELS, NULL);
+  g_return_val_if_fail (n_buckets != NULL, NULL);
+
+  buckets = self->levels[level];
+  seconds = og_timeline_get_bucket_seconds (level);
+
+  /* Indices of the first and past the last buckets */
+  first = MAX (og_div_floor (start, seconds), self->offsets[level]);
+  last = MIN (og_div_floor (end + seconds - 1, seconds),
+      self->offsets[level] + (gint64) buckets->len);
+  if (buckets->len == 0 || first >= last)
+    {
+      *n_buckets = 0;
+      return NULL;
+    }
+
+  if (buckets_start != NULL)
+    *buckets_start = first * seconds;
+  *n_buckets = last - first;
+
+  return &g_array_index (buckets, OgTimelineBucket,
+      first - self->offsets[level]);
+}
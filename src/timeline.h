@@ -0,0 +1,55 @@
+#ifndef __OG_TIMELINE_H__
+#define __OG_TIMELINE_H__
+
+#include <glib.h>
+
+#include "record.h"
+
+G_BEGIN_DECLS
+
+/* Width of the finest buckets, in seconds. Each level has buckets
+ * OG_TIMELINE_FANOUT times wider than the one below. */
+#define OG_TIMELINE_BUCKET_SECONDS (15 * 60)
+#define OG_TIMELINE_FANOUT 4
+/* The coarsest buckets are about 120 years wide */
+#define OG_TIMELINE_N_LEVELS 12
+
+/* Readings of a time bucket. Empty buckets have n_values at 0. */
+typedef struct
+{
+  guint32 n_values;
+  guint16 min;
+  guint16 max;
+  guint64 sum;
+} OgTimelineBucket;
+
+/* Min, max, mean and count of readings over the whole history, at several
+ * resolutions. Buckets are aligned on Unix time so records can be added in any
+ * order, each one updating a single bucket per level. Drawing any range then
+ * reads about as many buckets as there are pixels. */
+typedef struct _OgTimeline OgTimeline;
+
+OgTimeline *og_timeline_new (void);
+void og_timeline_free (OgTimeline *self);
+gsize og_timeline_get_size (const OgTimeline *self);
+
+guint og_timeline_get_n_records (const OgTimeline *self);
+void og_timeline_add_record (OgTimeline *self,
+    const OgRecord *record);
+
+gboolean og_timeline_get_range (const OgTimeline *self,
+    gint64 *first,
+    gint64 *last);
+
+gint64 og_timeline_get_bucket_seconds (guint level);
+guint og_timeline_get_level (gint64 seconds_per_bucket);
+const OgTimelineBucket *og_timeline_get_buckets (const OgTimeline *self,
+    guint level,
+    gint64 start,
+    gint64 end,
+    gint64 *buckets_start,
+    guint *n_buckets);
+
+G_END_DECLS
+
+#endif /* __OG_TIMELINE_H__ */
@@ -0,0 +1,308 @@
+#include "config.h"
+
+#include "trace.h"
+
+#include <unistd.h>
+
+#define DEBUG g_debug
+
+typedef struct
+{
+  gchar phase;
+  const gchar *name;
+  gchar *detail;
+  gint64 ts;
+  gconstpointer id;
+  gint64 value;
+  guint tid;
+} Event;
+
+typedef struct
+{
+  gchar *name;
+  gint64 ts;
+} Mark;
+
+gboolean og_trace_enabled = FALSE;
+gboolean og_trace_profile_startup = FALSE;
+
+static gchar *filename = NULL;
+/* GArray<Event> */
+static GArray *events = NULL;
+static GMutex events_lock;
+
+static gint64 start_time = 0;
+/* GArray<Mark> */
+static GArray *marks = NULL;
+
+static void
+event_clear (Event *event)
+{
+  g_free (event->detail);
+}
+
+static void
+mark_clear (Mark *mark)
+{
+  g_free (mark->name);
+}
+
+void
+og_trace_init (gboolean profile_startup)
+{
+  const gchar *path;
+
+  start_time = g_get_monotonic_time ();
+
+  if (profile_startup || g_getenv ("OPENGLUCOSE_PROFILE_STARTUP") != NULL)
+    {
+      marks = g_array_new (FALSE, FALSE, sizeof (Mark));
+      g_array_set_clear_func (marks, (GDestroyNotify) mark_clear);
+      og_trace_profile_startup = TRUE;
+    }
+
+  path = g_getenv ("OPENGLUCOSE_TRACE");
+  if (path == NULL || *path == '\0')
+    return;
+
+  filename = g_strdup (path);
+  events = g_array_sized_new (FALSE, FALSE, sizeof (Event), 4096);
+  g_array_set_clear_func (events, (GDestroyNotify) event_clear);
+  og_trace_enabled = TRUE;
+
+  DEBUG ("Tracing to %s", filename);
+}
+
+static void
+add_event (gchar phase,
+    const gchar *name,
+    gchar *detail,
+    gconstpointer id,
+    gint64 value)
+{
+  Event event;
+
+  event.phase = phase;
+  event.name = name;
+  event.detail = detail;
+  event.ts = g_get_monotonic_time ();
+  event.id = id;
+  event.value = value;
+  event.tid = g_direct_hash (g_thread_self ());
+
+  /* Worker threads may still be running when tracing is shut down, after
+   * their check of og_trace_enabled */
+  g_mutex_lock (&events_lock);
+  if (events != NULL)
+    g_array_append_val (events, event);
+  else
+    event_clear (&event);
+  g_mutex_unlock (&events_lock);
+}
+
+void
+og_trace_begin_real (const gchar *name)
+{
+  add_event ('B', name, NULL, NULL, 0);
+}
+
+void
+og_trace_end_real (const gchar *name)
+{
+  add_event ('E', name, NULL, NULL, 0);
+}
+
+void
+og_trace_async_begin_real (gconstpointer id,
+    const gchar *name,
+    const gchar *detail_format,
+    ...)
+{
+  gchar *detail;
+  va_list args;
+
+  va_start (args, detail_format);
+  detail = g_strdup_vprintf (detail_format, args);
+  va_end (args);
+
+  add_event ('b', name, detail, id, 0);
+}
+
+void
+og_trace_async_end_real (gconstpointer id,
+    const gchar *name)
+{
+  add_event ('e', name, NULL, id, 0);
+}
+
+void
+og_trace_counter_real (const gchar *name,
+    gint64 value)
+{
+  add_event ('C', name, NULL, NULL, value);
+}
+
+void
+og_trace_mark_real (const gchar *format,
+    ...)
+{
+  gchar *name;
+  va_list args;
+
+  va_start (args, format);
+  name = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  if (og_trace_enabled)
+    add_event ('i', "milestone", g_strdup (name), NULL, 0);
+
+  if (og_trace_profile_startup)
+    {
+      Mark mark;
+
+      mark.name = name;
+      mark.ts = g_get_monotonic_time ();
+
+      g_mutex_lock (&events_lock);
+      if (marks != NULL)
+        g_array_append_val (marks, mark);
+      else
+        mark_clear (&mark);
+      g_mutex_unlock (&events_lock);
+    }
+  else
+    {
+      g_free (name);
+    }
+}
+
+static void
+append_escaped (GString *string,
+    const gchar *str)
+{
+  guint i;
+
+  g_string_append_c (string, '"');
+  for (i = 0; str[i] != '\0'; i++)
+    {
+      if (str[i] == '"' || str[i] == '\\')
+        g_string_append_printf (string, "\\%c", str[i]);
+      else if ((guchar) str[i] < 0x20)
+        g_string_append_printf (string, "\\u%04x", (guchar) str[i]);
+      else
+        g_string_append_c (string, str[i]);
+    }
+  g_string_append_c (string, '"');
+}
+
+static void
+append_event (GString *string,
+    const Event *event,
+    gint64 start)
+{
+  g_string_append (string, "{\"name\":");
+  append_escaped (string, event->name);
+  g_string_append_printf (string,
+      ",\"cat\":\"openglucose\",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT
+      ",\"pid\":%d,\"tid\":%u",
+      event->phase, event->ts - start, (gint) getpid (), event->tid);
+
+  switch (event->phase)
+    {
+      case 'b':
+      case 'e':
+        g_string_append_printf (string, ",\"id\":\"%p\"", event->id);
+        if (event->detail != NULL)
+          {
+            g_string_append (string, ",\"args\":{\"detail\":");
+            append_escaped (string, event->detail);
+            g_string_append_c (string, '}');
+          }
+        break;
+      case 'i':
+        g_string_append (string, ",\"s\":\"g\",\"args\":{\"detail\":");
+        append_escaped (string, event->detail);
+        g_string_append_c (string, '}');
+        break;
+      case 'C':
+        g_string_append_printf (string,
+            ",\"args\":{\"value\":%" G_GINT64_FORMAT "}", event->value);
+        break;
+      default:
+        break;
+    }
+
+  g_string_append_c (string, '}');
+}
+
+static void
+print_startup_profile (void)
+{
+  gint64 previous = start_time;
+  guint i;
+
+  g_print ("Startup profile (ms since main, ms since previous milestone):\n");
+  for (i = 0; i < marks->len; i++)
+    {
+      const Mark *mark = &g_array_index (marks, Mark, i);
+
+      g_print ("%10.1f %10.1f  %s\n",
+          (mark->ts - start_time) / 1000.0,
+          (mark->ts - previous) / 1000.0,
+          mark->name);
+      previous = mark->ts;
+    }
+}
+
+void
+og_trace_shutdown (void)
+{
+  GString *string;
+  gint64 start;
+  guint i;
+  GError *error = NULL;
+
+  g_mutex_lock (&events_lock);
+
+  if (og_trace_profile_startup)
+    {
+      og_trace_profile_startup = FALSE;
+      print_startup_profile ();
+      g_clear_pointer (&marks, g_array_unref);
+    }
+
+  if (!og_trace_enabled)
+    {
+      g_mutex_unlock (&events_lock);
+      return;
+    }
+
+  og_trace_enabled = FALSE;
+
+  start = events->len > 0 ? g_array_index (events, Event, 0).ts : 0;
+
+  string = g_string_new ("{\"traceEvents\":[\n");
+  for (i = 0; i < events->len; i++)
+    {
+      if (i > 0)
+        g_string_append (string, ",\n");
+      append_event (string, &g_array_index (events, Event, i), start);
+    }
+  g_string_append (string, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  if (!g_file_set_contents (filename, string->str, string->len, &error))
+    {
+      g_warning ("Error writing trace file: %s", error->message);
+      g_clear_error (&error);
+    }
+  else
+    {
+      DEBUG ("Wrote %u trace events to %s", events->len, filename);
+    }
+
+  g_clear_pointer (&events, g_array_unref);
+  g_mutex_unlock (&events_lock);
+
+  g_string_free (string, TRUE);
+  g_clear_pointer (&filename, g_free);
+}
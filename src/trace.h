@@ -0,0 +1,82 @@
+#ifndef __OG_TRACE_H__
+#define __OG_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Opt-in tracing layer writing a Chrome trace-event JSON file, that can be
+ * loaded in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * It is enabled by setting OPENGLUCOSE_TRACE to the path of the file to write
+ * when the application quits. When disabled, each trace point costs a single
+ * branch on og_trace_enabled.
+ *
+ * Names must be static strings. og_trace_begin()/og_trace_end() must be
+ * balanced within the same main loop iteration, spans crossing async
+ * boundaries must use og_trace_async_begin()/og_trace_async_end() with the
+ * same id.
+ *
+ * Startup profiling is enabled by the --profile-startup command line option or
+ * by setting OPENGLUCOSE_PROFILE_STARTUP. Milestones recorded with
+ * og_trace_mark() are then printed with their time since main() on exit. They
+ * also appear as instant "milestone" events when tracing. */
+
+extern gboolean og_trace_enabled;
+extern gboolean og_trace_profile_startup;
+
+void og_trace_init (gboolean profile_startup);
+void og_trace_shutdown (void);
+
+void og_trace_begin_real (const gchar *name);
+void og_trace_end_real (const gchar *name);
+void og_trace_async_begin_real (gconstpointer id,
+    const gchar *name,
+    const gchar *detail_format,
+    ...) G_GNUC_PRINTF (3, 4);
+void og_trace_async_end_real (gconstpointer id,
+    const gchar *name);
+void og_trace_counter_real (const gchar *name,
+    gint64 value);
+void og_trace_mark_real (const gchar *format,
+    ...) G_GNUC_PRINTF (1, 2);
+
+#define og_trace_begin(name) \
+  G_STMT_START { \
+    if (G_UNLIKELY (og_trace_enabled)) \
+      og_trace_begin_real (name); \
+  } G_STMT_END
+
+#define og_trace_end(name) \
+  G_STMT_START { \
+    if (G_UNLIKELY (og_trace_enabled)) \
+      og_trace_end_real (name); \
+  } G_STMT_END
+
+#define og_trace_async_begin(id, name, ...) \
+  G_STMT_START { \
+    if (G_UNLIKELY (og_trace_enabled)) \
+      og_trace_async_begin_real (id, name, __VA_ARGS__); \
+  } G_STMT_END
+
+#define og_trace_async_end(id, name) \
+  G_STMT_START { \
+    if (G_UNLIKELY (og_trace_enabled)) \
+      og_trace_async_end_real (id, name); \
+  } G_STMT_END
+
+#define og_trace_counter(name, value) \
+  G_STMT_START { \
+    if (G_UNLIKELY (og_trace_enabled)) \
+      og_trace_counter_real (name, value); \
+  } G_STMT_END
+
+#define og_trace_mark(...) \
+  G_STMT_START { \
+    if (G_UNLIKELY (og_trace_enabled || og_trace_profile_startup)) \
+      og_trace_mark_real (__VA_ARGS__); \
+  } G_STMT_END
+
+G_END_DECLS
+
+#endif /* __OG_TRACE_H__ */
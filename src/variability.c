@@ -0,0 +1,277 @@
+#include "config.h"
+
+#include "variability.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "stats.h"
+
+/* Compact the history once that many samples are outdated */
+#define HISTORY_COMPACT_THRESHOLD 1024
+
+typedef struct
+{
+  gint64 time;
+  guint glycemia;
+} Sample;
+
+struct _OgVariabilityBuilder
+{
+  OgMoments moments;
+  gdouble low_risk;
+  gdouble high_risk;
+
+  /* GArray<Sample> of readings within OG_VARIABILITY_MODD_LAG (plus
+   * tolerance) of the last one, starting at index head. Cursors are where
+   * the previous lookup of each lag ended, lagged times only move forward. */
+  GArray *history;
+  guint head;
+  guint conga_cursor;
+  guint modd_cursor;
+
+  OgMoments conga;
+  gdouble modd_sum;
+  guint modd_n_values;
+
+  /* GArray<guint> local extrema, with the first reading, in time order */
+  GArray *extrema;
+  guint previous;
+  gint direction;
+};
+
+OgVariabilityBuilder *
+og_variability_builder_new (void)
+{
+  OgVariabilityBuilder *self;
+
+  self = g_slice_new0 (OgVariabilityBuilder);
+  self->history = g_array_new (FALSE, FALSE, sizeof (Sample));
+  self->extrema = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return self;
+}
+
+void
+og_variability_builder_free (OgVariabilityBuilder *self)
+{
+  if (self == NULL)
+    return;
+
+  g_array_unref (self->history);
+  g_array_unref (self->extrema);
+  g_slice_free (OgVariabilityBuilder, self);
+}
+
+/* Returns the sample closest to @target, if within tolerance */
+static const Sample *
+find_lagged (OgVariabilityBuilder *self,
+    guint *cursor,
+    gint64 target)
+{
+  const Sample *samples = (const Sample *) self->history->data;
+  const Sample *best;
+  guint len = self->history->len;
+  guint i;
+
+  i = MAX (*cursor, self->head);
+  if (i >= len)
+    return NULL;
+
+  while (i + 1 < len && samples[i + 1].time <= target)
+    i++;
+  *cursor = i;
+
+  best = &samples[i];
+  if (i + 1 < len &&
+      ABS (samples[i + 1].time - target) < ABS (best->time - target))
+    best = &samples[i + 1];
+
+  if (ABS (best->time - target) > OG_VARIABILITY_LAG_TOLERANCE)
+    return NULL;
+
+  return best;
+}
+
+static void
+forget_old_samples (OgVariabilityBuilder *self,
+    gint64 time)
+{
+  const Sample *samples = (const Sample *) self->history->data;
+  gint64 oldest = time - OG_VARIABILITY_MODD_LAG -
+      OG_VARIABILITY_LAG_TOLERANCE;
+
+  while (self->head < self->history->len &&
+      samples[self->head].time < oldest)
+    self->head++;
+
+  if (self->head < HISTORY_COMPACT_THRESHOLD ||
+      self->head < self->history->len / 2)
+    return;
+
+  g_array_remove_range (self->history, 0, self->head);
+  self->conga_cursor -= MIN (self->conga_cursor, self->head);
+  self->modd_cursor -= MIN (self->modd_cursor, self->head);
+  self->head = 0;
+}
+
+/* @time is in seconds and must not be before the previous reading */
+void
+og_variability_builder_add (OgVariabilityBuilder *self,
+    gint64 time,
+    guint glycemia)
+{
+  const Sample *lagged;
+  Sample sample;
+  gdouble f;
+
+  g_return_if_fail (self != NULL);
+
+  glycemia = MAX (glycemia, 1);
+  og_moments_add (&self->moments, glycemia);
+
+  /* Risk transform of Kovatchev et al., symmetric in the mg/dl scale */
+  f = 1.509 * (pow (log (glycemia), 1.084) - 5.381);
+  if (f < 0)
+    self->low_risk += 10 * f * f;
+  else
+    self->high_risk += 10 * f * f;
+
+  lagged = find_lagged (self, &self->conga_cursor,
+      time - OG_VARIABILITY_CONGA_LAG);
+  if (lagged != NULL)
+    og_moments_add (&self->conga, (gdouble) glycemia - lagged->glycemia);
+
+  lagged = find_lagged (self, &self->modd_cursor,
+      time - OG_VARIABILITY_MODD_LAG);
+  if (lagged != NULL)
+    {
+      self->modd_sum += ABS ((gint) glycemia - (gint) lagged->glycemia);
+      self->modd_n_values++;
+    }
+
+  forget_old_samples (self, time);
+  sample.time = time;
+  sample.glycemia = glycemia;
+  g_array_append_val (self->history, sample);
+
+  /* Keep turning points only, plateaus are skipped */
+  if (self->moments.n_values == 1)
+    {
+      g_array_append_val (self->extrema, glycemia);
+    }
+  else if (glycemia != self->previous)
+    {
+      gint direction = glycemia > self->previous ? 1 : -1;
+
+      if (self->direction != 0 && direction != self->direction)
+        g_array_append_val (self->extrema, self->previous);
+      self->direction = direction;
+    }
+  self->previous = glycemia;
+}
+
+/* Excursions are legs between turning points confirmed by a reversal of more
+ * than @sd. MAGE is the mean of those in the direction of the first one. */
+static gdouble
+compute_mage (const guint *values,
+    guint n_values,
+    gdouble sd)
+{
+  gdouble sums[2] = { 0, 0 };
+  guint counts[2] = { 0, 0 };
+  gint first = -1;
+  gdouble lo, hi, turn = 0, extreme = 0;
+  gint direction = 0;
+  guint i;
+
+  if (n_values == 0 || sd <= 0)
+    return 0;
+
+  lo = hi = values[0];
+  for (i = 1; i < n_values; i++)
+    {
+      gdouble v = values[i];
+
+      if (direction == 0)
+        {
+          if (v - lo > sd)
+            {
+              direction = 1;
+              turn = lo;
+              extreme = v;
+            }
+          else if (hi - v > sd)
+            {
+              direction = -1;
+              turn = hi;
+              extreme = v;
+            }
+          lo = MIN (lo, v);
+          hi = MAX (hi, v);
+        }
+      else if (direction * (v - extreme) >= 0)
+        {
+          extreme = v;
+        }
+      else if (ABS (v - extreme) > sd)
+        {
+          /* 1 for rising excursions, 0 for falling ones */
+          guint rising = direction > 0;
+
+          sums[rising] += ABS (extreme - turn);
+          counts[rising]++;
+          if (first < 0)
+            first = rising;
+
+          turn = extreme;
+          extreme = v;
+          direction = -direction;
+        }
+    }
+
+  /* The last leg, if large enough */
+  if (direction != 0 && ABS (extreme - turn) > sd)
+    {
+      guint rising = direction > 0;
+
+      sums[rising] += ABS (extreme - turn);
+      counts[rising]++;
+      if (first < 0)
+        first = rising;
+    }
+
+  if (first < 0)
+    return 0;
+
+  return sums[first] / counts[first];
+}
+
+void
+og_variability_builder_finish (OgVariabilityBuilder *self,
+    OgVariability *variability)
+{
+  guint n_values;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (variability != NULL);
+
+  memset (variability, 0, sizeof (OgVariability));
+
+  n_values = self->moments.n_values;
+  if (n_values == 0)
+    return;
+
+  variability->n_values = n_values;
+  variability->lbgi = self->low_risk / n_values;
+  variability->hbgi = self->high_risk / n_values;
+  variability->conga = og_moments_get_sd (&self->conga);
+  if (self->modd_n_values > 0)
+    variability->modd = self->modd_sum / self->modd_n_values;
+
+  /* The last reading ends the last excursion */
+  g_array_append_val (self->extrema, self->previous);
+  variability->mage = compute_mage ((const guint *) self->extrema->data,
+      self->extrema->len, og_moments_get_sd (&self->moments));
+  g_array_set_size (self->extrema, self->extrema->len - 1);
+}
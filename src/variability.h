@@ -0,0 +1,48 @@
+#ifndef __OG_VARIABILITY_H__
+#define __OG_VARIABILITY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Readings are matched with the one closest to the lag before them, if
+ * within that tolerance, in seconds */
+#define OG_VARIABILITY_LAG_TOLERANCE (15 * 60)
+#define OG_VARIABILITY_CONGA_LAG (60 * 60)
+#define OG_VARIABILITY_MODD_LAG (24 * 60 * 60)
+
+/* Glycemic variability indices, in mg/dl except the unitless risk indices.
+ * Indices lacking enough readings are 0. */
+typedef struct
+{
+  guint n_values;
+  /* Mean amplitude of glycemic excursions above 1 SD */
+  gdouble mage;
+  /* Low and high blood glucose indices */
+  gdouble lbgi;
+  gdouble hbgi;
+  /* Continuous overall net glycemic action: SD of differences with the
+   * reading an hour before */
+  gdouble conga;
+  /* Mean of daily differences: mean absolute difference with the reading
+   * a day before */
+  gdouble modd;
+} OgVariability;
+
+/* Computes the indices in a single pass over readings added in time order.
+ * Only the readings of the last day are kept for lag lookups, and local
+ * extrema for MAGE. */
+typedef struct _OgVariabilityBuilder OgVariabilityBuilder;
+
+OgVariabilityBuilder *og_variability_builder_new (void);
+void og_variability_builder_free (OgVariabilityBuilder *self);
+
+void og_variability_builder_add (OgVariabilityBuilder *self,
+    gint64 time,
+    guint glycemia);
+void og_variability_builder_finish (OgVariabilityBuilder *self,
+    OgVariability *variability);
+
+G_END_DECLS
+
+#endif /* __OG_VARIABILITY_H__ */